@@ -12,23 +12,1344 @@
 
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
 #include "../Helpers/APDefines.h"
+#include "../Helpers/APMath.h"
+
+namespace
+{
+  const auto log9         = std::log(9.0);
+  const auto minusInfGain = juce::Decibels::decibelsToGain(APConstants::Math::MINUS_INF_DB, -200.0f);
+
+  using APMath::decibelsToGain;
+  using APMath::fastLog2;
+  using APMath::log2ToDecibels;
+
+  using Coefficients = APCompressorBase::SmoothingCoefficients;
+
+  // Model policies. Every combination is compiled into its own copy of the per-sample loops, see
+  // APCompressor::selectKernel.
+
+  // Level detectors: what the key is reduced to before the dB conversion
+  struct PeakLevel
+  {
+    static constexpr bool meanSquare = false;
+  };
+
+  // Produces the mean square rather than the RMS; the dB conversion halves the log instead of taking a sqrt
+  struct WindowedRMSLevel
+  {
+    static constexpr bool meanSquare = true;
+  };
+
+  // Knees. The hard knee is the soft one with the quadratic section gone, selected when the width is 0.
+  struct SoftKnee
+  {
+    static constexpr bool hard = false;
+  };
+
+  struct HardKnee
+  {
+    static constexpr bool hard = true;
+  };
+
+  // Characters: where the smoother's coefficients come from. depth is how hard the detector is driven, 0 to 1.
+  struct VCA
+  {
+    static float attack(const Coefficients& alpha) { return alpha.attack; }
+    static float release(const Coefficients& alpha, float) { return alpha.release; }
+  };
+
+  struct Opto
+  {
+    static float attack(const Coefficients& alpha) { return alpha.optoAttack; }
+    static float release(const Coefficients& alpha, const float depth)
+    {
+      return alpha.release + (alpha.optoRelease - alpha.release) * juce::jlimit(0.0f, 1.0f, depth);
+    }
+  };
+
+  // Smoothers. Gain change smoothers run after the static curve and attack while the reduction deepens.
+  struct PeakSmoother
+  {
+    static constexpr bool levelDomain = false;
+    static constexpr bool meanSquare  = false;
+    template <typename Character>
+    static float smooth(const float gainChangeDb, const float prev, const Coefficients& alpha)
+    {
+      const auto a = gainChangeDb < prev ? Character::attack(alpha)
+                                         : Character::release(alpha, -prev / APCompressorBase::OPTO_RANGE_DB);
+      return a * prev + (1.0f - a) * gainChangeDb;
+    }
+  };
+
+  struct RMSSmoother
+  {
+    static constexpr bool levelDomain = false;
+    static constexpr bool meanSquare  = true;
+    template <typename Character>
+    static float smooth(const float gainChangeDb, const float prev, const Coefficients& alpha)
+    {
+      const auto a = gainChangeDb < prev ? Character::attack(alpha)
+                                         : Character::release(alpha, -prev / APCompressorBase::OPTO_RANGE_DB);
+      return -std::sqrt((1.0f - a) * gainChangeDb * gainChangeDb + a * prev * prev);
+    }
+  };
+
+  // Smooths the level (dB) ahead of the static curve and attacks while it rises
+  struct LogLevelSmoother
+  {
+    static constexpr bool levelDomain = true;
+    static constexpr bool meanSquare  = false;
+    template <typename Character>
+    static float smooth(const float levelDb, const float prev, const Coefficients& alpha)
+    {
+      const auto a = levelDb > prev ? Character::attack(alpha)
+                                    : Character::release(alpha, 1.0f + prev / APCompressorBase::OPTO_RANGE_DB);
+      return a * prev + (1.0f - a) * levelDb;
+    }
+  };
+
+  struct FeedForward
+  {
+    static constexpr bool feedback = false;
+  };
+
+  struct FeedBack
+  {
+    static constexpr bool feedback = true;
+  };
+
+  template <typename LevelType, typename SmootherType>
+  struct DetectorModel
+  {
+    using Level    = LevelType;
+    using Smoother = SmootherType;
+  };
+
+  // Policy lists in the order of the matching APCompressorBase enums
+  using Detectors  = std::tuple<DetectorModel<PeakLevel, PeakSmoother>, DetectorModel<PeakLevel, RMSSmoother>,
+                               DetectorModel<WindowedRMSLevel, PeakSmoother>,
+                               DetectorModel<PeakLevel, LogLevelSmoother>>;
+  using Knees      = std::tuple<SoftKnee, HardKnee>;
+  using Topologies = std::tuple<FeedForward, FeedBack>;
+  using Characters = std::tuple<VCA, Opto>;
+
+  constexpr auto numKnees      = std::tuple_size_v<Knees>;
+  constexpr auto numTopologies = std::tuple_size_v<Topologies>;
+  constexpr auto numCharacters = std::tuple_size_v<Characters>;
+  constexpr auto numModels     = std::tuple_size_v<Detectors> * numKnees * numTopologies * numCharacters;
+
+  // Model number Index of the kernel table, [detector][knee][topology][character]
+  template <size_t Index>
+  struct Model
+  {
+    using Detector  = std::tuple_element_t<Index / (numCharacters * numTopologies * numKnees), Detectors>;
+    using Level     = typename Detector::Level;
+    using Smoother  = typename Detector::Smoother;
+    using Knee      = std::tuple_element_t<Index / (numCharacters * numTopologies) % numKnees, Knees>;
+    using Topology  = std::tuple_element_t<Index / numCharacters % numTopologies, Topologies>;
+    using Character = std::tuple_element_t<Index % numCharacters, Characters>;
+  };
+
+  // Static curve in the dB domain, the scalar form of the SIMD loops below
+  template <typename Knee>
+  float gainChangeDb(const float xDb, const float threshold, const float slope, const float halfWidth,
+                     const float kneeWidth, const float invTwoWidth)
+  {
+    if constexpr (Knee::hard)
+    {
+      juce::ignoreUnused(halfWidth, kneeWidth, invTwoWidth);
+      return slope * juce::jmax(0.0f, xDb - threshold);
+    }
+    else
+    {
+      const auto inKnee = juce::jlimit(0.0f, kneeWidth, xDb - (threshold - halfWidth));
+      const auto above  = juce::jmax(0.0f, xDb - (threshold + halfWidth));
+      return slope * invTwoWidth * inKnee * inKnee + slope * above;
+    }
+  }
+
+  // One step of the windowed mean square. Re-sums the window once per trip around the ring so rounding in the
+  // running sum cannot accumulate; amortised this is less than one extra add per sample.
+  inline float stepMeanSquare(float* squares, const uint32_t mask, const uint32_t window, const float scale,
+                              uint32_t& position, float& sum, const float square)
+  {
+    sum                      += square - squares[(position - window) & mask];
+    squares[position & mask]  = square;
+    ++position;
+
+    if ((position & mask) == 0)
+    {
+      sum = 0.0f;
+      for (uint32_t k = 1; k <= window; ++k)
+        sum += squares[(position - k) & mask];
+    }
+
+    return juce::jmax(0.0f, sum) * scale;
+  }
+
+  // One-pole TPT high-pass: the input less its trapezoidal low-pass, so the response is flat above the cutoff and
+  // falls at 6 dB/oct below it. gain is g / (1 + g).
+  template <typename SampleType>
+  SampleType keyHighPass(const SampleType x, const SampleType gain, SampleType& integrator)
+  {
+    const auto v   = (x - integrator) * gain;
+    const auto low = v + integrator;
+    integrator     = low + v;
+    return x - low;
+  }
+
+}  // namespace
+
+float APCompressorBase::smoothingCoefficient(const float sampleRate, const float time)
+{
+  if (sampleRate <= 0.0f || time <= 0.0f)
+    return 0.0f;
+  return static_cast<float>(std::exp(-log9 / static_cast<double>(sampleRate * time)));
+}
+
+template <typename SampleType>
+APCompressor<SampleType>::APCompressor()
+{
+  activeCurve_ = lastPublished_ = &curves_[0];
+  publishCurve();
+}
+
+template <typename SampleType>
+APCompressor<SampleType>::~APCompressor() = default;
+
+template <typename SampleType>
+void APCompressor<SampleType>::prepare(const float sampleRate, const int numChannels)
+{
+  sampleRate_ = sampleRate;
+  updateSmoothingCoefficients();
+
+  // The delay line holds the lookahead plus one chunk, since a whole chunk is written before it is read back
+  const auto maxLookahead = lookaheadToSamples(MAX_LOOKAHEAD, sampleRate);
+  const auto delaySize    = static_cast<size_t>(juce::nextPowerOfTwo(maxLookahead + CHUNK_SIZE + 1));
+  const auto peakSize     = static_cast<size_t>(juce::nextPowerOfTwo(maxLookahead + 1));
+  const auto squaresSize  = static_cast<size_t>(juce::nextPowerOfTwo(juce::roundToInt(MAX_RMS_WINDOW * sampleRate) + 1));
+
+  channels_.resize(static_cast<size_t>(juce::jmax(1, numChannels)));
+  for (auto& state : channels_)
+  {
+    state.delay.assign(delaySize, SampleType(0));
+    state.peakLevels.assign(peakSize, 0.0f);
+    state.peakPositions.assign(peakSize, 0u);
+    state.squares.assign(squaresSize, 0.0f);
+    state.threshold.reset(sampleRate, APConstants::Math::PARAMETER_RAMP_TIME);
+    state.slope.reset(sampleRate, APConstants::Math::PARAMETER_RAMP_TIME);
+    state.kneeWidth.reset(sampleRate, APConstants::Math::PARAMETER_RAMP_TIME);
+  }
+
+  setLookahead(lookahead_);
+  setRMSWindow(rmsWindow_);
+  setKeyFilter(keyFilterEnabled_, keyFilterFrequency_);
+  reset();
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::reset()
+{
+  snapCurve_ = true;
+  for (auto& state : channels_)
+  {
+    state.clear();
+    state.threshold.setCurrentAndTargetValue(activeCurve_->threshold);
+    state.slope.setCurrentAndTargetValue(activeCurve_->slope);
+    state.kneeWidth.setCurrentAndTargetValue(activeCurve_->kneeWidth);
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::ChannelState::clear()
+{
+  prevGainSmooth  = 0.0f;
+  prevLevelSmooth = APConstants::Math::MINUS_INF_DB;
+  feedback        = 0;
+  controlPhase    = 0;
+  controlLevel    = 0.0f;
+  controlGain     = 1.0f;
+  controlStep     = 0.0f;
+  std::fill(delay.begin(), delay.end(), SampleType(0));
+  position = peakHead = peakTail = 0;
+  std::fill(squares.begin(), squares.end(), 0.0f);
+  rmsPosition = 0;
+  rmsSum      = 0.0f;
+  keyState    = 0;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::ChannelState::follow(const ChannelState& from)
+{
+  prevGainSmooth  = from.prevGainSmooth;
+  prevLevelSmooth = from.prevLevelSmooth;
+  controlPhase    = from.controlPhase;
+  controlLevel    = from.controlLevel;
+  controlGain     = from.controlGain;
+  controlStep     = from.controlStep;
+  // Every channel's delay moves in step, so positions in from's deque hold here too
+  peakLevels    = from.peakLevels;
+  peakPositions = from.peakPositions;
+  peakHead      = from.peakHead;
+  peakTail      = from.peakTail;
+  squares       = from.squares;
+  rmsPosition   = from.rmsPosition;
+  rmsSum        = from.rmsSum;
+  threshold     = from.threshold;
+  slope         = from.slope;
+  kneeWidth     = from.kneeWidth;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::updateParameters(const float threshold, const float ratio)
+{
+  const std::lock_guard<std::mutex> lock(writerMutex_);
+  setCurve(threshold, ratio, kneeWidth_);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::updateParameters(const float threshold, const float ratio, const float kneeWidth)
+{
+  const std::lock_guard<std::mutex> lock(writerMutex_);
+  setCurve(threshold, ratio, kneeWidth);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setCurve(const float threshold, const float ratio, const float kneeWidth)
+{
+  if (threshold == threshold_ && ratio == ratio_ && kneeWidth == kneeWidth_)
+    return;
+
+  threshold_ = threshold;
+  ratio_     = ratio;
+  kneeWidth_ = juce::jmax(0.0f, kneeWidth);
+  publishCurve();
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setAttack(const float attack)
+{
+  attack_ = attack;
+  updateSmoothingCoefficients();
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setRelease(const float release)
+{
+  release_ = release;
+  updateSmoothingCoefficients();
+}
+
+int APCompressorBase::lookaheadToSamples(const float lookahead, const float sampleRate)
+{
+  return juce::roundToInt(juce::jlimit(0.0f, MAX_LOOKAHEAD, lookahead) * juce::jmax(0.0f, sampleRate));
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setLookahead(const float lookahead)
+{
+  lookahead_ = juce::jlimit(0.0f, MAX_LOOKAHEAD, lookahead);
+
+  const auto lookaheadSamples = lookaheadToSamples(lookahead_, sampleRate_);
+  if (lookaheadSamples != lookaheadSamples_)
+  {
+    lookaheadSamples_ = lookaheadSamples;
+    for (auto& state : channels_)  // stale delay contents would replay at the new offset
+      state.clear();
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setRMSWindow(const float window)
+{
+  rmsWindow_ = juce::jlimit(0.0f, MAX_RMS_WINDOW, window);
+
+  const auto windowSamples = juce::jmax(1, juce::roundToInt(rmsWindow_ * sampleRate_));
+  if (windowSamples != rmsWindowSamples_)
+  {
+    rmsWindowSamples_ = windowSamples;
+    for (auto& state : channels_)
+    {
+      std::fill(state.squares.begin(), state.squares.end(), 0.0f);
+      state.rmsSum = 0.0f;
+    }
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setKeyFilter(const bool enabled, const float frequency)
+{
+  keyFilterEnabled_   = enabled;
+  keyFilterFrequency_ = frequency;
+  if (sampleRate_ <= 0.0f)
+    return;
+
+  // Prewarped so the corner lands on frequency, kept below Nyquist
+  const auto corner = juce::jlimit(1.0, 0.49 * static_cast<double>(sampleRate_), static_cast<double>(frequency));
+  const auto g      = std::tan(juce::MathConstants<double>::pi * corner / static_cast<double>(sampleRate_));
+  keyFilterGain_    = static_cast<float>(g / (1.0 + g));
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setControlInterval(const int interval)
+{
+  const auto clamped = juce::jlimit(1, MAX_CONTROL_INTERVAL, juce::nextPowerOfTwo(juce::jmax(1, interval)));
+  if (clamped == controlInterval_)
+    return;
+
+  controlInterval_ = clamped;
+  updateSmoothingCoefficients();
+  for (auto& state : channels_)
+  {
+    state.controlPhase = 0;
+    state.controlLevel = 0.0f;
+    state.controlStep  = 0.0f;
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setChannelLink(const ChannelLink link)
+{
+  if (link == link_)
+    return;
+
+  link_ = link;
+  for (auto& state : channels_)
+    state.relinked = true;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setKneeWidth(const float kneeWidth)
+{
+  const std::lock_guard<std::mutex> lock(writerMutex_);
+  setCurve(threshold_, ratio_, kneeWidth);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::setCurveMode(const CurveMode mode)
+{
+  const std::lock_guard<std::mutex> lock(writerMutex_);
+  if (mode == curveMode_)
+    return;
+
+  curveMode_ = mode;
+  publishCurve();
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::updateSmoothingCoefficients()
+{
+  alpha_.attack      = smoothingCoefficient(sampleRate_, attack_);
+  alpha_.release     = smoothingCoefficient(sampleRate_, release_);
+  alpha_.optoAttack  = juce::jmax(alpha_.attack, smoothingCoefficient(sampleRate_, OPTO_ATTACK));
+  alpha_.optoRelease = smoothingCoefficient(sampleRate_, release_ * OPTO_RELEASE_STRETCH);
+
+  // One step per interval: the same one-pole decay over controlInterval_ samples
+  const auto interval        = static_cast<float>(controlInterval_);
+  controlAlpha_.attack       = std::pow(alpha_.attack, interval);
+  controlAlpha_.release      = std::pow(alpha_.release, interval);
+  controlAlpha_.optoAttack   = std::pow(alpha_.optoAttack, interval);
+  controlAlpha_.optoRelease  = std::pow(alpha_.optoRelease, interval);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::publishCurve()
+{
+  // A curve still parked in pendingCurve_ was never seen by the audio thread and can be rewritten. Otherwise the
+  // audio thread has taken lastPublished_, so the other slot is free.
+  auto* curve = pendingCurve_.exchange(nullptr, std::memory_order_acq_rel);
+  if (curve == nullptr)
+    curve = lastPublished_ == &curves_[0] ? &curves_[1] : &curves_[0];
+
+  curve->threshold = threshold_;
+  curve->kneeLow   = threshold_ - kneeWidth_ / 2;
+  curve->kneeHigh  = threshold_ + kneeWidth_ / 2;
+  curve->kneeWidth = kneeWidth_;
+  curve->slope     = 1 / ratio_ - 1;
+  curve->kneeScale = kneeWidth_ > 0.0f ? curve->slope / (2 * kneeWidth_) : 0.0f;
+  curve->useTable  = curveMode_ == CurveMode::LookupTable;
+
+  if (curve->useTable)
+  {
+    constexpr auto dbPerPoint = -APConstants::Math::MINUS_INF_DB / CURVE_TABLE_SIZE;
+    for (int i = 0; i <= CURVE_TABLE_SIZE; ++i)
+    {
+      const auto xDb                       = APConstants::Math::MINUS_INF_DB + static_cast<float>(i) * dbPerPoint;
+      curve->table[static_cast<size_t>(i)] = curve->gainChangeDb(xDb);
+    }
+  }
+
+  pendingCurve_.store(curve, std::memory_order_release);
+  lastPublished_ = curve;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::updateActiveCurve()
+{
+  if (pendingCurve_.load(std::memory_order_relaxed) != nullptr)
+  {
+    if (auto* curve = pendingCurve_.exchange(nullptr, std::memory_order_acq_rel))
+    {
+      activeCurve_ = curve;
+      for (auto& channelState : channels_)
+      {
+        if (snapCurve_)
+        {
+          channelState.threshold.setCurrentAndTargetValue(curve->threshold);
+          channelState.slope.setCurrentAndTargetValue(curve->slope);
+          channelState.kneeWidth.setCurrentAndTargetValue(curve->kneeWidth);
+        }
+        else
+        {
+          channelState.threshold.setTargetValue(curve->threshold);
+          channelState.slope.setTargetValue(curve->slope);
+          channelState.kneeWidth.setTargetValue(curve->kneeWidth);
+        }
+      }
+    }
+  }
+  snapCurve_ = false;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::process(const int channel, const SampleType* audioIn, const SampleType* keyIn,
+                                       SampleType* audioOut, const int numSamplesToRender)
+{
+  updateActiveCurve();
+  const auto& curve = *activeCurve_;
+
+  const Channels channels { &audioIn, keyIn != nullptr ? &keyIn : nullptr, &audioOut, channel, 1 };
+  const auto kernel = selectKernel(curve, keyIn != nullptr);
+  (this->*kernel)(curve, channels, numSamplesToRender);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::process(const SampleType* const* audioIn, const SampleType* const* keyIn,
+                                       SampleType* const* audioOut, const int firstChannel, const int numChannels,
+                                       const int numSamplesToRender)
+{
+  // Linked, only the first channel's detector runs. After a change of link mode the others pick up from it rather
+  // than from wherever they stopped.
+  auto& shared = channels_[static_cast<size_t>(firstChannel)];
+  if (shared.relinked)
+  {
+    for (int c = 1; c < numChannels; ++c)
+      channels_[static_cast<size_t>(firstChannel + c)].follow(shared);
+    for (int c = 0; c < numChannels; ++c)
+      channels_[static_cast<size_t>(firstChannel + c)].relinked = false;
+  }
+
+  updateActiveCurve();
+  const auto& curve = *activeCurve_;
+  const auto kernel = selectKernel(curve, keyIn != nullptr);
+
+  (this->*kernel)(curve, { audioIn, keyIn, audioOut, firstChannel, numChannels }, numSamplesToRender);
+}
+
+template <typename SampleType>
+template <size_t... Index>
+constexpr std::array<typename APCompressor<SampleType>::Kernel, sizeof...(Index)>
+APCompressor<SampleType>::makeKernels(std::index_sequence<Index...>)
+{
+  return { &APCompressor::processChannel<Model<Index>>... };
+}
+
+template <typename SampleType>
+typename APCompressor<SampleType>::Kernel APCompressor<SampleType>::selectKernel(const GainCurve& curve,
+                                                                                 const bool externalKey) const
+{
+  static constexpr auto kernels = makeKernels(std::make_index_sequence<numModels>());
+
+  // [detector][knee][topology][character], matching Model. A knee still ramping down to 0 dB needs the soft one.
+  const auto hardKnee = curve.kneeWidth == 0.0f && std::none_of(channels_.begin(), channels_.end(), [](const auto& s) {
+                          return s.kneeWidth.isRamping();
+                        });
+  const auto feedback = topology_ == Topology::FeedBack && !externalKey;
+  auto index          = static_cast<size_t>(detector_);
+  index               = index * numKnees + (hardKnee ? 1 : 0);
+  index               = index * numTopologies + (feedback ? 1 : 0);
+  index               = index * numCharacters + static_cast<size_t>(character_);
+  return kernels[index];
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::processChannel(const GainCurve& curve, const Channels& channels,
+                                              const int numSamplesToRender)
+{
+  using Level    = typename Model::Level;
+  using Smoother = typename Model::Smoother;
+
+  if (channels.count > 1 && link_ == ChannelLink::Off)
+  {
+    processParallel<Model>(curve, channels, numSamplesToRender);
+    return;
+  }
+
+  if constexpr (Model::Topology::feedback)
+  {
+    // One instantiation per link mode and key filter setting, so the sample loop tests neither. A single channel,
+    // or Off (which only reaches here one channel at a time), takes the key as it is, the same as Max.
+    const auto feedback = [&](auto link) {
+      if (keyFilterEnabled_)
+        processFeedback<Model, decltype(link)::value, true>(curve, channels, numSamplesToRender);
+      else
+        processFeedback<Model, decltype(link)::value, false>(curve, channels, numSamplesToRender);
+    };
+    switch (channels.count > 1 ? link_ : ChannelLink::Max)
+    {
+      case ChannelLink::Mean: feedback(std::integral_constant<ChannelLink, ChannelLink::Mean> {}); break;
+      case ChannelLink::RMSSum: feedback(std::integral_constant<ChannelLink, ChannelLink::RMSSum> {}); break;
+      case ChannelLink::Off:
+      case ChannelLink::Max: feedback(std::integral_constant<ChannelLink, ChannelLink::Max> {}); break;
+    }
+    return;
+  }
+
+  auto& state = channels_[static_cast<size_t>(channels.first)];
+
+  for (int start = 0; start < numSamplesToRender; start += CHUNK_SIZE)
+  {
+    const auto numSamples = juce::jmin(CHUNK_SIZE, numSamplesToRender - start);
+
+    // Decided per chunk rather than per call, so the gain releases into 1:1 at the same sample however the host
+    // splits its blocks
+    const auto unity = isUnity(curve, state);
+    if (unity)
+      state.skipCurve(numSamples);
+
+    // 1:1 with no stateful detector: the detector output is never used, so nothing but the copy remains
+    if (unity && !Level::meanSquare && lookaheadSamples_ == 0)
+    {
+      for (int c = 0; c < channels.count; ++c)
+      {
+        // The key filter keeps running so its state is current when the ratio moves off 1:1
+        const auto* key = channels.keyIn != nullptr ? channels.keyIn[c] : channels.audioIn[c];
+        if (keyFilterEnabled_)
+          filterKey(channels_[static_cast<size_t>(channels.first + c)], key + start, numSamples);
+        if (channels.audioOut[c] != channels.audioIn[c])
+          std::memcpy(channels.audioOut[c] + start, channels.audioIn[c] + start,
+                      static_cast<size_t>(numSamples) * sizeof(SampleType));
+      }
+      continue;
+    }
+
+    const auto* key = linkKeys(channels, start, numSamples);  // vectorised
+
+    if constexpr (Level::meanSquare)
+      detectWindowedRMS(state, key, numSamples);  // serial, O(1) per sample
+    else
+      detectPeak(key, numSamples);
+
+    if (lookaheadSamples_ > 0)
+      detectPeakWindow(state, numSamples);  // serial, O(1) per sample
+
+    // Detectors keep running through unity so their windows are current when the ratio moves off 1:1
+    if (!unity)
+    {
+      toDecibels<Level>(numSamples);  // vectorised
+      if (controlInterval_ > 1)
+      {
+        if constexpr (!Smoother::levelDomain)
+          computeGainChangeDb<typename Model::Knee>(curve, state, numSamples);  // vectorised
+        computeControlRateGain<Model>(state, numSamples);
+      }
+      else
+      {
+        if constexpr (Smoother::levelDomain)
+          smoothLevel<Model>(state, numSamples);  // serial, recursive
+        computeGainChangeDb<typename Model::Knee>(curve, state, numSamples);  // vectorised
+        if constexpr (!Smoother::levelDomain)
+          smoothGainChange<Model>(state, numSamples);  // serial, recursive
+        toLinearGain(numSamples);  // vectorised
+      }
+    }
+
+    applyGain(channels, start, numSamples, unity);  // vectorised, once per channel
+  }
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::processParallel(const GainCurve& curve, const Channels& channels,
+                                               const int numSamplesToRender)
+{
+  using Level    = typename Model::Level;
+  using Smoother = typename Model::Smoother;
+
+  const auto single = [&](const int c) {
+    return Channels { channels.audioIn + c, channels.keyIn != nullptr ? channels.keyIn + c : nullptr,
+                      channels.audioOut + c, channels.first + c, 1 };
+  };
+
+  for (int batch = 0; batch < channels.count; batch += PARALLEL_CHANNELS)
+  {
+    const auto numLanes    = juce::jmin(PARALLEL_CHANNELS, channels.count - batch);
+    const auto canParallel = !Model::Topology::feedback && controlInterval_ == 1 && numLanes > 1;
+
+    // Spare lanes idle at 0 dB
+    if (numLanes < PARALLEL_CHANNELS)
+      std::fill(lanes_.begin(), lanes_.end(), 0.0f);
+
+    for (int start = 0; start < numSamplesToRender; start += CHUNK_SIZE)
+    {
+      const auto numSamples = juce::jmin(CHUNK_SIZE, numSamplesToRender - start);
+
+      // Chosen per chunk, like processChannel's unity check, so one channel settling into 1:1 switches the batch
+      // at the same sample whatever the block split
+      auto parallel = canParallel;
+      for (int lane = 0; parallel && lane < numLanes; ++lane)
+        parallel = !isUnity(curve, channels_[static_cast<size_t>(channels.first + batch + lane)]);
+
+      if (!parallel)
+      {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+          const SampleType* in  = channels.audioIn[batch + lane] + start;
+          const SampleType* key = channels.keyIn != nullptr ? channels.keyIn[batch + lane] + start : nullptr;
+          SampleType* out       = channels.audioOut[batch + lane] + start;
+          processChannel<Model>(curve, { &in, key != nullptr ? &key : nullptr, &out, channels.first + batch + lane, 1 },
+                                numSamples);
+        }
+        continue;
+      }
+
+      // Smoother state in lanes, spare lanes at 0 dB
+      alignas(32) std::array<float, PARALLEL_CHANNELS> prev {};
+      for (int lane = 0; lane < numLanes; ++lane)
+      {
+        const auto& state = channels_[static_cast<size_t>(channels.first + batch + lane)];
+        prev[static_cast<size_t>(lane)] = Smoother::levelDomain ? state.prevLevelSmooth : state.prevGainSmooth;
+      }
+
+      auto* gain  = gain_.data();
+      auto* lanes = lanes_.data();
+
+      // Everything up to the smoother, one channel at a time, transposed into its lane
+      for (int lane = 0; lane < numLanes; ++lane)
+      {
+        auto& state     = channels_[static_cast<size_t>(channels.first + batch + lane)];
+        const auto* key = linkKeys(single(batch + lane), start, numSamples);  // vectorised
+
+        if constexpr (Level::meanSquare)
+          detectWindowedRMS(state, key, numSamples);  // serial, O(1) per sample
+        else
+          detectPeak(key, numSamples);
+
+        if (lookaheadSamples_ > 0)
+          detectPeakWindow(state, numSamples);  // serial, O(1) per sample
+
+        toDecibels<Level>(numSamples);  // vectorised
+        if constexpr (!Smoother::levelDomain)
+          computeGainChangeDb<typename Model::Knee>(curve, state, numSamples);  // vectorised
+
+        for (int i = 0; i < numSamples; ++i)
+          lanes[i * PARALLEL_CHANNELS + lane] = gain[i];
+      }
+
+      smoothLanes<Model>(prev.data(), numSamples);  // serial in time, vectorised across channels
+
+      // And back, for the rest of each channel's chain
+      for (int lane = 0; lane < numLanes; ++lane)
+      {
+        auto& state = channels_[static_cast<size_t>(channels.first + batch + lane)];
+        for (int i = 0; i < numSamples; ++i)
+          gain[i] = lanes[i * PARALLEL_CHANNELS + lane];
+
+        if constexpr (Smoother::levelDomain)
+          computeGainChangeDb<typename Model::Knee>(curve, state, numSamples);  // vectorised
+        toLinearGain(numSamples);  // vectorised
+        applyGain(single(batch + lane), start, numSamples, false);
+
+        (Smoother::levelDomain ? state.prevLevelSmooth : state.prevGainSmooth) = prev[static_cast<size_t>(lane)];
+      }
+    }
+  }
+}
+
+template <typename SampleType>
+template <typename Model, APCompressorBase::ChannelLink link, bool keyFiltered>
+void APCompressor<SampleType>::processFeedback(const GainCurve& curve, const Channels& channels,
+                                               const int numSamplesToRender)
+{
+  using Level           = typename Model::Level;
+  using Smoother        = typename Model::Smoother;
+  using Knee            = typename Model::Knee;
+  using CharacterPolicy = typename Model::Character;
+
+  auto& state = channels_[static_cast<size_t>(channels.first)];
+
+  // Per-sample constants, hoisted. The lookahead still delays the audio so the reported latency holds, but a
+  // feedback detector can only see the past.
+  constexpr auto meanSquare = Level::meanSquare;
+  const auto floor          = meanSquare ? minusInfGain * minusInfGain : minusInfGain;
+  const auto dbScale        = meanSquare ? log2ToDecibels * 0.5f : log2ToDecibels;
+  const auto keyGain        = static_cast<SampleType>(keyFilterGain_);
+  const auto window         = static_cast<uint32_t>(rmsWindowSamples_);
+  const auto mask           = static_cast<uint32_t>(state.squares.size() - 1);
+  const auto rmsScale       = 1.0f / static_cast<float>(window);
+  const auto alpha          = alpha_;
+  const auto linkScale      = 1.0f / static_cast<float>(channels.count);
+  auto* threshold           = thresholdRamp_.data();
+  auto* slope               = slopeRamp_.data();
+  auto* kneeWidth           = kneeRamp_.data();
+  auto* invTwoWidth         = invTwoWidthRamp_.data();
+
+  for (int start = 0; start < numSamplesToRender; start += CHUNK_SIZE)
+  {
+    const auto numSamples = juce::jmin(CHUNK_SIZE, numSamplesToRender - start);
+
+    // Delayed input goes straight to the output and is scaled there in place
+    if (lookaheadSamples_ > 0)
+      for (int c = 0; c < channels.count; ++c)
+        delayChunk(channels_[static_cast<size_t>(channels.first + c)], channels.audioIn[c] + start,
+                   channels.audioOut[c] + start, numSamples);
 
+    // Per chunk, as in processChannel
+    if (isUnity(curve, state))
+    {
+      state.skipCurve(numSamples);
+      for (int c = 0; c < channels.count; ++c)
+      {
+        auto* output = channels.audioOut[c] + start;
+        if (lookaheadSamples_ == 0 && output != channels.audioIn[c] + start)
+          std::memcpy(output, channels.audioIn[c] + start, static_cast<size_t>(numSamples) * sizeof(SampleType));
+        channels_[static_cast<size_t>(channels.first + c)].feedback = output[numSamples - 1];
+      }
+      continue;
+    }
 
+    if (state.isCurveRamping())
+    {
+      state.threshold.fill(threshold, numSamples);
+      state.slope.fill(slope, numSamples);
+      fillKneeRamp(state, numSamples);
+    }
+    else
+    {
+      std::fill(threshold, threshold + numSamples, curve.threshold);
+      std::fill(slope, slope + numSamples, curve.slope);
+      std::fill(kneeWidth, kneeWidth + numSamples, curve.kneeWidth);
+      std::fill(invTwoWidth, invTwoWidth + numSamples, curve.kneeWidth > 0.0f ? 1 / (2 * curve.kneeWidth) : 0.0f);
+    }
 
-APCompressor::APCompressor() = default;
+    for (int i = 0; i < numSamples; ++i)
+    {
+      // Previous output frame, filtered and linked into one key
+      auto linked = 0.0f;
+      for (int c = 0; c < channels.count; ++c)
+      {
+        auto& channelState = channels_[static_cast<size_t>(channels.first + c)];
+        auto key           = static_cast<float>(channelState.feedback);
+        if constexpr (keyFiltered)
+          key = static_cast<float>(keyHighPass(channelState.feedback, keyGain, channelState.keyState));
+        if constexpr (link == ChannelLink::RMSSum)
+          linked += key * key;
+        else if constexpr (link == ChannelLink::Mean)
+          linked += std::abs(key);
+        else
+          linked = juce::jmax(linked, std::abs(key));
+      }
+      if constexpr (link == ChannelLink::RMSSum)
+        linked = std::sqrt(linked * linkScale);
+      else if constexpr (link == ChannelLink::Mean)
+        linked *= linkScale;
 
-APCompressor::~APCompressor() = default;
+      auto level = linked;
+      if constexpr (meanSquare)
+        level = stepMeanSquare(state.squares.data(), mask, window, rmsScale, state.rmsPosition, state.rmsSum,
+                               linked * linked);
 
-void APCompressor::process(const float* audioIn, float* audioOut, const int numSamplesToRender)
+      auto xDb = fastLog2(juce::jmax(level, floor)) * dbScale;
+      if constexpr (Smoother::levelDomain)
+        xDb = state.prevLevelSmooth =
+            Smoother::template smooth<CharacterPolicy>(xDb, state.prevLevelSmooth, alpha);
+
+      auto gainDb =
+          gainChangeDb<Knee>(xDb, threshold[i], slope[i], kneeWidth[i] / 2, kneeWidth[i], invTwoWidth[i]);
+      if constexpr (!Smoother::levelDomain)
+        gainDb = state.prevGainSmooth =
+            Smoother::template smooth<CharacterPolicy>(gainDb, state.prevGainSmooth, alpha);
+
+      const auto gain = static_cast<SampleType>(decibelsToGain(gainDb));
+      for (int c = 0; c < channels.count; ++c)
+      {
+        const auto* input = lookaheadSamples_ > 0 ? channels.audioOut[c] : channels.audioIn[c];
+        auto& output      = channels.audioOut[c][start + i];
+        output            = input[start + i] * gain;
+        channels_[static_cast<size_t>(channels.first + c)].feedback = output;
+      }
+    }
+  }
+}
+
+template <typename SampleType>
+bool APCompressor<SampleType>::isUnity(const GainCurve& curve, ChannelState& state) const
+{
+  // The threshold has no effect on a 1:1 curve, so only the slope has to be settled
+  if (curve.slope != 0.0f || state.slope.isRamping() || state.slope.getCurrentValue() != 0.0f ||
+      std::abs(state.prevGainSmooth) >= UNITY_GAIN_CHANGE_DB)
+    return false;
+
+  state.prevGainSmooth = 0.0f;
+  state.controlGain    = 1.0f;
+  state.controlStep    = 0.0f;
+  return true;
+}
+
+template <typename SampleType>
+const SampleType* APCompressor<SampleType>::linkKeys(const Channels& channels, const int start, const int numSamples)
+{
+  const auto keyOf = [&](const int c) {
+    const auto* key = (channels.keyIn != nullptr ? channels.keyIn[c] : channels.audioIn[c]) + start;
+    return keyFilterEnabled_ ? filterKey(channels_[static_cast<size_t>(channels.first + c)], key, numSamples) : key;
+  };
+
+  if (channels.count == 1)
+    return keyOf(0);
+
+  // Whole-chunk passes per channel, so the link mode is tested once per chunk, never per sample
+  auto* linked = linked_.data();
+  for (int c = 0; c < channels.count; ++c)
+  {
+    const auto* key = keyOf(c);
+    if (c == 0)
+    {
+      for (int i = 0; i < numSamples; ++i)
+        linked[i] = link_ == ChannelLink::RMSSum ? key[i] * key[i] : std::abs(key[i]);
+      continue;
+    }
+
+    switch (link_)
+    {
+      case ChannelLink::Off:
+      case ChannelLink::Max:
+        for (int i = 0; i < numSamples; ++i)
+          linked[i] = juce::jmax(linked[i], std::abs(key[i]));
+        break;
+      case ChannelLink::Mean:
+        for (int i = 0; i < numSamples; ++i)
+          linked[i] += std::abs(key[i]);
+        break;
+      case ChannelLink::RMSSum:
+        for (int i = 0; i < numSamples; ++i)
+          linked[i] += key[i] * key[i];
+        break;
+    }
+  }
+
+  const auto scale = SampleType(1) / static_cast<SampleType>(channels.count);
+  if (link_ == ChannelLink::Mean)
+    for (int i = 0; i < numSamples; ++i)
+      linked[i] *= scale;
+  else if (link_ == ChannelLink::RMSSum)
+    for (int i = 0; i < numSamples; ++i)
+      linked[i] = std::sqrt(linked[i] * scale);
+
+  return linked;
+}
+
+template <typename SampleType>
+const SampleType* APCompressor<SampleType>::filterKey(ChannelState& state, const SampleType* keyIn,
+                                                      const int numSamples)
+{
+  // Recursive, so serial, at a handful of operations per sample
+  const auto gain = static_cast<SampleType>(keyFilterGain_);
+  auto* key       = key_.data();
+  for (int i = 0; i < numSamples; ++i)
+    key[i] = keyHighPass(keyIn[i], gain, state.keyState);
+  return key;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::detectPeak(const SampleType* keyIn, const int numSamples)
+{
+  auto* gain = gain_.data();
+  if constexpr (std::is_same_v<SampleType, float>)
+    juce::FloatVectorOperations::abs(gain, keyIn, numSamples);
+  else
+    for (int i = 0; i < numSamples; ++i)
+      gain[i] = static_cast<float>(std::abs(keyIn[i]));
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::detectWindowedRMS(ChannelState& state, const SampleType* audioIn, const int numSamples)
 {
-  for (int i = 0; i < numSamplesToRender; ++i)
+  const auto window = static_cast<uint32_t>(rmsWindowSamples_);
+  const auto mask   = static_cast<uint32_t>(state.squares.size() - 1);
+  const auto scale  = 1.0f / static_cast<float>(window);
+  auto* squares     = state.squares.data();
+  auto position     = state.rmsPosition;
+  auto sum          = state.rmsSum;
+  auto* gain        = gain_.data();
+
+  for (int i = 0; i < numSamples; ++i)
   {
-    audioOut[i] = applyRMSCompression(audioIn[i]);
+    const auto sample = static_cast<float>(audioIn[i]);
+    gain[i]           = stepMeanSquare(squares, mask, window, scale, position, sum, sample * sample);
   }
+
+  state.rmsPosition = position;
+  state.rmsSum      = sum;
 }
 
-std::pair<float, float> APCompressor::_applyRMSCompression(const float sample, const float sampleRate, const float threshold,
+template <typename SampleType>
+void APCompressor<SampleType>::detectPeakWindow(ChannelState& state, const int numSamples)
+{
+  const auto window = static_cast<uint32_t>(lookaheadSamples_);
+  const auto mask   = static_cast<uint32_t>(state.peakLevels.size() - 1);
+  auto* levels      = state.peakLevels.data();
+  auto* positions   = state.peakPositions.data();
+  auto head         = state.peakHead;
+  auto tail         = state.peakTail;
+  auto* gain        = gain_.data();
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const auto position = state.position + static_cast<uint32_t>(i);
+    const auto level    = gain[i];
+
+    // Anything smaller than the newest level can never be the window maximum again
+    while (tail != head && levels[(tail - 1) & mask] <= level)
+      --tail;
+    levels[tail & mask]    = level;
+    positions[tail & mask] = position;
+    ++tail;
+
+    // Drop the front once it is older than the window [position - lookahead, position]
+    while (position - positions[head & mask] > window)
+      ++head;
+
+    gain[i] = levels[head & mask];
+  }
+
+  state.peakHead = head;
+  state.peakTail = tail;
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::delayChunk(ChannelState& state, const SampleType* audioIn, SampleType* audioOut,
+                                          const int numSamples)
+{
+  const auto size = static_cast<uint32_t>(state.delay.size());
+  const auto mask = size - 1;
+  auto* delay     = state.delay.data();
+
+  const auto count = static_cast<uint32_t>(numSamples);
+
+  // At most two contiguous copies per direction. The write completes before the read, so audioOut may alias audioIn.
+  const auto writeStart = state.position & mask;
+  const auto writeFirst = juce::jmin(count, size - writeStart);
+  std::memcpy(delay + writeStart, audioIn, writeFirst * sizeof(SampleType));
+  std::memcpy(delay, audioIn + writeFirst, (count - writeFirst) * sizeof(SampleType));
+
+  const auto readStart = (state.position - static_cast<uint32_t>(lookaheadSamples_)) & mask;
+  const auto readFirst = juce::jmin(count, size - readStart);
+  std::memcpy(audioOut, delay + readStart, readFirst * sizeof(SampleType));
+  std::memcpy(audioOut + readFirst, delay, (count - readFirst) * sizeof(SampleType));
+
+  state.position += count;
+}
+
+template <typename SampleType>
+template <typename Level>
+void APCompressor<SampleType>::toDecibels(const int numSamples)
+{
+  auto* gain = gain_.data();
+
+  // dB, clamped at MINUS_INF_DB. A mean square level takes half the log, which saves the sqrt.
+  constexpr auto squared = Level::meanSquare;
+  const auto floor       = squared ? minusInfGain * minusInfGain : minusInfGain;
+  const auto scale       = squared ? log2ToDecibels * 0.5f : log2ToDecibels;
+  juce::FloatVectorOperations::max(gain, gain, floor, numSamples);
+  for (int i = 0; i < numSamples; ++i)
+    gain[i] = fastLog2(gain[i]) * scale;
+}
+
+template <typename SampleType>
+template <typename Knee>
+void APCompressor<SampleType>::computeGainChangeDb(const GainCurve& curve, ChannelState& state, const int numSamples)
+{
+  using SIMD           = juce::dsp::SIMDRegister<float>;
+  constexpr auto lanes = static_cast<int>(SIMD::SIMDNumElements);
+
+  auto* gain = gain_.data();
+
+  if (state.isCurveRamping())
+  {
+    computeRampedGainChangeDb(state, numSamples);
+    return;
+  }
+
+  if (curve.useTable)
+  {
+    // One interpolated lookup per sample. Input is already clamped at MINUS_INF_DB; overs beyond the table's
+    // 0 dBFS end are rare and evaluated analytically.
+    constexpr auto pointsPerDb = CURVE_TABLE_SIZE / -APConstants::Math::MINUS_INF_DB;
+    const auto* table          = curve.table.data();
+    for (int i = 0; i < numSamples; ++i)
+    {
+      const auto xDb = gain[i];
+      if (xDb > 0.0f)
+      {
+        gain[i] = curve.gainChangeDb(xDb);
+        continue;
+      }
+      const auto position = (xDb - APConstants::Math::MINUS_INF_DB) * pointsPerDb;
+      const auto index    = juce::jmin(static_cast<int>(position), CURVE_TABLE_SIZE - 1);
+      const auto fraction = position - static_cast<float>(index);
+      gain[i]             = table[index] + fraction * (table[index + 1] - table[index]);
+    }
+    return;
+  }
+
+  // Same expression as GainCurve::gainChangeDb, SIMD lanes at a time.
+  // Lanes past numSamples hold stale but finite values and are never read back.
+  if constexpr (Knee::hard)
+  {
+    const auto threshold = SIMD::expand(curve.threshold);
+    const auto slope     = SIMD::expand(curve.slope);
+    const auto zero      = SIMD::expand(0.0f);
+    for (int i = 0; i < numSamples; i += lanes)
+      (slope * SIMD::max(SIMD::fromRawArray(gain + i) - threshold, zero)).copyToRawArray(gain + i);
+    return;
+  }
+
+  const auto kneeLow   = SIMD::expand(curve.kneeLow);
+  const auto kneeHigh  = SIMD::expand(curve.kneeHigh);
+  const auto kneeWidth = SIMD::expand(curve.kneeWidth);
+  const auto kneeScale = SIMD::expand(curve.kneeScale);
+  const auto slope     = SIMD::expand(curve.slope);
+  const auto zero      = SIMD::expand(0.0f);
+
+  for (int i = 0; i < numSamples; i += lanes)
+  {
+    const auto xDb    = SIMD::fromRawArray(gain + i);
+    const auto inKnee = SIMD::min(SIMD::max(xDb - kneeLow, zero), kneeWidth);
+    const auto above  = SIMD::max(xDb - kneeHigh, zero);
+    (kneeScale * inKnee * inKnee + slope * above).copyToRawArray(gain + i);
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::computeRampedGainChangeDb(ChannelState& state, const int numSamples)
+{
+  using SIMD           = juce::dsp::SIMDRegister<float>;
+  constexpr auto lanes = static_cast<int>(SIMD::SIMDNumElements);
+
+  auto* gain        = gain_.data();
+  auto* threshold   = thresholdRamp_.data();
+  auto* slope       = slopeRamp_.data();
+  auto* kneeWidth   = kneeRamp_.data();
+  auto* invTwoWidth = invTwoWidthRamp_.data();
+  state.threshold.fill(threshold, numSamples);
+  state.slope.fill(slope, numSamples);
+  fillKneeRamp(state, numSamples);
+
+  // GainCurve::gainChangeDb with every term rebuilt per lane
+  const auto half = SIMD::expand(0.5f);
+  const auto zero = SIMD::expand(0.0f);
+
+  for (int i = 0; i < numSamples; i += lanes)
+  {
+    const auto xDb       = SIMD::fromRawArray(gain + i);
+    const auto thr       = SIMD::fromRawArray(threshold + i);
+    const auto s         = SIMD::fromRawArray(slope + i);
+    const auto width     = SIMD::fromRawArray(kneeWidth + i);
+    const auto halfWidth = width * half;
+    const auto inKnee    = SIMD::min(SIMD::max(xDb - (thr - halfWidth), zero), width);
+    const auto above     = SIMD::max(xDb - (thr + halfWidth), zero);
+    (s * SIMD::fromRawArray(invTwoWidth + i) * inKnee * inKnee + s * above).copyToRawArray(gain + i);
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::fillKneeRamp(ChannelState& state, const int numSamples)
+{
+  auto* kneeWidth   = kneeRamp_.data();
+  auto* invTwoWidth = invTwoWidthRamp_.data();
+  state.kneeWidth.fill(kneeWidth, numSamples);
+  for (int i = 0; i < numSamples; ++i)
+    invTwoWidth[i] = kneeWidth[i] > 0.0f ? 0.5f / kneeWidth[i] : 0.0f;
+}
+
+template <typename SampleType>
+float APCompressor<SampleType>::GainCurve::gainChangeDb(const float xDb) const
+{
+  const auto inKnee = juce::jlimit(0.0f, kneeWidth, xDb - kneeLow);
+  const auto above  = juce::jmax(0.0f, xDb - kneeHigh);
+  return kneeScale * inKnee * inKnee + slope * above;
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::smoothLevel(ChannelState& state, const int numSamples)
+{
+  using CharacterPolicy = typename Model::Character;
+
+  // Block-local copies keep the coefficients in registers for the whole loop
+  const auto alpha     = alpha_;
+  auto prevLevelSmooth = state.prevLevelSmooth;
+  auto* level          = gain_.data();
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    prevLevelSmooth = Model::Smoother::template smooth<CharacterPolicy>(level[i], prevLevelSmooth, alpha);
+    level[i]        = prevLevelSmooth;
+  }
+
+  state.prevLevelSmooth = prevLevelSmooth;
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::smoothGainChange(ChannelState& state, const int numSamples)
+{
+  using CharacterPolicy = typename Model::Character;
+
+  // Block-local copies keep the coefficients in registers for the whole loop
+  const auto alpha    = alpha_;
+  auto prevGainSmooth = state.prevGainSmooth;
+  auto* gain          = gain_.data();
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    prevGainSmooth = Model::Smoother::template smooth<CharacterPolicy>(gain[i], prevGainSmooth, alpha);
+    gain[i]        = prevGainSmooth;
+  }
+
+  state.prevGainSmooth = prevGainSmooth;
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::smoothLanes(float* prev, const int numSamples)
+{
+  using CharacterPolicy = typename Model::Character;
+
+  const auto alpha = alpha_;
+  auto* lanes      = lanes_.data();
+
+  // Fixed lane count, so the inner loop is one register wide with no remainder
+  for (int i = 0; i < numSamples; ++i)
+  {
+    auto* frame = lanes + i * PARALLEL_CHANNELS;
+    for (int lane = 0; lane < PARALLEL_CHANNELS; ++lane)
+    {
+      prev[lane]  = Model::Smoother::template smooth<CharacterPolicy>(frame[lane], prev[lane], alpha);
+      frame[lane] = prev[lane];
+    }
+  }
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::toLinearGain(const int numSamples)
+{
+  // Convert back to linear amplitude scalar
+  decibelsToGain(gain_.data(), gain_.data(), numSamples);
+}
+
+template <typename SampleType>
+void APCompressor<SampleType>::applyGain(const Channels& channels, const int start, const int numSamples,
+                                         const bool unity)
+{
+  const auto* gain = gain_.data();
+  for (int c = 0; c < channels.count; ++c)
+  {
+    const auto* input = channels.audioIn[c] + start;
+    auto* output      = channels.audioOut[c] + start;
+    if (lookaheadSamples_ > 0)
+    {
+      delayChunk(channels_[static_cast<size_t>(channels.first + c)], input, output, numSamples);
+      input = output;
+    }
+
+    if (unity)
+    {
+      if (output != input)
+        std::memcpy(output, input, static_cast<size_t>(numSamples) * sizeof(SampleType));
+    }
+    else if constexpr (std::is_same_v<SampleType, float>)
+    {
+      juce::FloatVectorOperations::multiply(output, input, gain, numSamples);
+    }
+    else
+    {
+      for (int i = 0; i < numSamples; ++i)
+        output[i] = input[i] * static_cast<SampleType>(gain[i]);
+    }
+  }
+}
+
+template <typename SampleType>
+template <typename Model>
+void APCompressor<SampleType>::computeControlRateGain(ChannelState& state, const int numSamples)
+{
+  using Smoother        = typename Model::Smoother;
+  using CharacterPolicy = typename Model::Character;
+
+  // The decimated detector signal is whatever the smoother averages: the level for a log-domain smoother, the
+  // gain change otherwise, squared for the RMS smoother. Over an interval the one-pole is then one step on the mean.
+  constexpr auto levelDomain = Smoother::levelDomain;
+  constexpr auto squared     = Smoother::meanSquare;
+  const auto interval        = controlInterval_;
+  const auto scale           = 1.0f / static_cast<float>(interval);
+  auto* gain                 = gain_.data();
+
+  // Runs from one interval boundary to the next, so the per-sample work is a sum and a ramp over each segment
+  for (int begin = 0; begin < numSamples;)
+  {
+    const auto count = juce::jmin(interval - state.controlPhase, numSamples - begin);
+    auto sum         = 0.0f;
+    for (int i = begin; i < begin + count; ++i)
+      sum += squared ? gain[i] * gain[i] : gain[i];
+    state.controlLevel += sum;
+
+    const auto start = state.controlGain;
+    const auto step  = state.controlStep;
+    for (int i = 0; i < count; ++i)
+      gain[begin + i] = start + step * static_cast<float>(i + 1);
+    state.controlGain = gain[begin + count - 1];
+
+    if constexpr (levelDomain)
+      state.skipCurve(count);
+    state.controlPhase = (state.controlPhase + count) & (interval - 1);
+    begin += count;
+
+    if (state.controlPhase != 0)
+      continue;
+
+    // Interval complete: one smoother step and one exp, and the next interval ramps to the result
+    const auto mean    = state.controlLevel * scale;
+    state.controlLevel = 0.0f;
+    auto gainDb        = 0.0f;
+    if constexpr (levelDomain)
+    {
+      state.prevLevelSmooth =
+          Smoother::template smooth<CharacterPolicy>(mean, state.prevLevelSmooth, controlAlpha_);
+      const auto kneeWidth = state.kneeWidth.getCurrentValue();
+      gainDb = gainChangeDb<typename Model::Knee>(state.prevLevelSmooth, state.threshold.getCurrentValue(),
+                                                  state.slope.getCurrentValue(), kneeWidth / 2, kneeWidth,
+                                                  kneeWidth > 0.0f ? 1 / (2 * kneeWidth) : 0.0f);
+    }
+    else
+    {
+      const auto gainChange = squared ? -std::sqrt(mean) : mean;
+      gainDb = state.prevGainSmooth =
+          Smoother::template smooth<CharacterPolicy>(gainChange, state.prevGainSmooth, controlAlpha_);
+    }
+    state.controlStep = (decibelsToGain(gainDb) - state.controlGain) * scale;
+  }
+}
+
+std::pair<float, float> APCompressorBase::_applyRMSCompression(const float sample, const float sampleRate, const float threshold,
                                                            const float ratio, const float attack, const float release,
                                                            const float kneeWidth, const float prevGainSmoothed)
 {
@@ -72,10 +1393,13 @@ std::pair<float, float> APCompressor::_applyRMSCompression(const float sample, c
   return { xOut, gainSmooth };
 }
 
-float APCompressor::applyRMSCompression(const float sample)
+template <typename SampleType>
+SampleType APCompressor<SampleType>::applyRMSCompression(const SampleType sample)
 {
-  const auto [result, gainSmoothed] =
-      _applyRMSCompression(sample, sampleRate_, threshold_, ratio_, attack_, release_, kneeWidth_, prevGainSmooth_);
-  prevGainSmooth_ = gainSmoothed;
+  SampleType result = 0;
+  process(&sample, &result, 1);
   return result;
 }
+
+template class APCompressor<float>;
+template class APCompressor<double>;
@@ -9,38 +9,347 @@
 */
 
 #pragma once
+#include <array>
+#include <atomic>
+#include <mutex>
 #include <utility>
+#include <vector>
 
-class APCompressor
+#include "../Helpers/APParameterRamp.h"
+
+// Sample-type independent part of APCompressor: modes, limits and the reference implementation
+class APCompressorBase
 {
  public:
-  APCompressor();
-  ~APCompressor();
+  enum class CurveMode
+  {
+    Analytic,     // evaluate the soft knee per sample
+    LookupTable,  // interpolate a table baked by updateParameters
+  };
 
-  void setSampleRate(const float sampleRate) { sampleRate_ = sampleRate; }
-  void updateParameters(const float threshold, const float ratio)
+  enum class Detector
   {
-    threshold_ = threshold;
-    ratio_     = ratio;
-  }
-  void reset()
+    Peak,         // |x|, linear attack/release smoothing
+    ApproxRMS,    // |x|, smoothing on the squared gain change (the original behaviour)
+    WindowedRMS,  // true RMS over setRMSWindow, linear attack/release smoothing
+    LogPeak,      // |x|, attack/release smoothing of the level in dB, before the static curve
+  };
+
+  // How the channels of one process() call share a detector
+  enum class ChannelLink
   {
-    prevGainSmooth_ = 0.0f;
-  }
+    Off,     // every channel detects and compresses on its own
+    Max,     // loudest channel's |key|
+    Mean,    // mean of the channels' |key|
+    RMSSum,  // sqrt of the mean of the channels' key^2, the power sum
+  };
+
+  enum class Topology
+  {
+    FeedForward,  // detector reads the input (or the external key)
+    FeedBack,     // detector reads the previous output sample. An external key always feeds forward.
+  };
+
+  enum class Character
+  {
+    VCA,   // fixed attack and release
+    Opto,  // attack no faster than OPTO_ATTACK, release slowing up to OPTO_RELEASE_STRETCH times with drive
+  };
+
+  // One-pole coefficients for every character, see smoothingCoefficient
+  struct SmoothingCoefficients
+  {
+    float attack      = 0.0f;
+    float release     = 0.0f;
+    float optoAttack  = 0.0f;
+    float optoRelease = 0.0f;
+  };
+
+  static constexpr float MAX_LOOKAHEAD  = 0.01f;  // seconds, see APCompressor::setLookahead
+  static constexpr float MAX_RMS_WINDOW = 0.1f;   // seconds, see APCompressor::setRMSWindow
+  // Smoothed gain changes smaller than this are within a float ulp of unity gain
+  static constexpr float UNITY_GAIN_CHANGE_DB = 1.0e-6f;
+  static constexpr float OPTO_ATTACK          = 0.01f;  // seconds
+  static constexpr float OPTO_RELEASE_STRETCH = 5.0f;
+  static constexpr float OPTO_RANGE_DB        = 20.0f;  // drive at which the opto release is slowest
+  static constexpr int MAX_CONTROL_INTERVAL   = 32;     // samples, see APCompressor::setControlInterval
 
-  void process(const float* audioIn, float* audioOut, int numSamplesToRender);
+  static int lookaheadToSamples(float lookahead, float sampleRate);
+  // One-pole coefficient that reaches 90% of a step after time seconds
+  static float smoothingCoefficient(float sampleRate, float time);
 
+  // Reference implementation, recomputes every coefficient per call. Kept for tests and comparisons.
   static std::pair<float, float> _applyRMSCompression(float sample,  float sampleRate, float threshold, float ratio,
                       float attack, float release, float kneeWidth,
                       float prevGainSmoothed) ;
-  float applyRMSCompression(float sample);
+};
+
+// Audio runs at SampleType. The detector and gain computer work in float at either precision: levels only need to
+// be accurate to a fraction of a dB, and the float path is the one that vectorises widest.
+template <typename SampleType>
+class APCompressor : public APCompressorBase
+{
+ public:
+  APCompressor();
+  ~APCompressor();
+
+  // Allocates per-channel detector state and the lookahead buffers. Not real-time safe.
+  void prepare(float sampleRate, int numChannels);
+  void setSampleRate(float sampleRate) { prepare(sampleRate, static_cast<int>(channels_.size())); }
+  // Time constants in seconds. Coefficients are recomputed here, never per sample.
+  void setAttack(float attack);
+  void setRelease(float release);
+  // Delays the signal so the detector sees peaks before they arrive. Up to MAX_LOOKAHEAD seconds, 0 disables.
+  void setLookahead(float lookahead);
+  int getLatencySamples() const { return lookaheadSamples_; }
+  // Detector, topology and character, with the knee (hard when the width is 0), select one compiled model per
+  // process() call. The per-sample loops have no mode tests.
+  void setDetector(Detector detector) { detector_ = detector; }
+  void setTopology(Topology topology) { topology_ = topology; }
+  void setCharacter(Character character) { character_ = character; }
+  // Samples per smoother update: 1 (every sample) or a power of two up to MAX_CONTROL_INTERVAL. Above 1 the
+  // smoother steps once per interval on the interval's mean and the linear gain is interpolated in between, one
+  // interval behind the detector. Feed-forward only, feedback always runs per sample.
+  void setControlInterval(int interval);
+  // Linked channels share the first channel's detector and gain computer: one level per sample frame, one gain
+  // curve, and the gain applied to every channel. Only the multichannel process() links. On a change of mode the
+  // other channels of each group start from the first channel's detector, so no channel resumes from stale state.
+  void setChannelLink(ChannelLink link);
+  // Window length in seconds for Detector::WindowedRMS, up to MAX_RMS_WINDOW
+  void setRMSWindow(float window);
+  // First-order high-pass on the detector key: low end rolled off below frequency (Hz), flat above it
+  void setKeyFilter(bool enabled, float frequency);
+
+  // Static curve setters. These rebuild the curve (and table) on the calling thread and hand it to process()
+  // lock-free, so they can be called from one non-audio thread while audio is running. Threshold and ratio changes
+  // ramp in over APConstants::Math::PARAMETER_RAMP_TIME.
+  void updateParameters(float threshold, float ratio);
+  void updateParameters(float threshold, float ratio, float kneeWidth);
+  void setKneeWidth(float kneeWidth);
+  void setCurveMode(CurveMode mode);
+  void reset();
+
+  void process(const SampleType* audioIn, SampleType* audioOut, const int numSamplesToRender)
+  {
+    process(0, audioIn, audioOut, numSamplesToRender);
+  }
+  void process(int channel, const SampleType* audioIn, SampleType* audioOut, const int numSamplesToRender)
+  {
+    process(channel, audioIn, nullptr, audioOut, numSamplesToRender);
+  }
+  // keyIn drives the detector when not null (external sidechain). It is read in place, never copied.
+  void process(int channel, const SampleType* audioIn, const SampleType* keyIn, SampleType* audioOut,
+               int numSamplesToRender);
+  // Channels firstChannel to firstChannel + numChannels - 1 together, linked as set by setChannelLink. The pointer
+  // arrays hold numChannels entries starting at firstChannel's, keyIn is null or holds one key per channel.
+  // Unlinked channels run their smoothers side by side, PARALLEL_CHANNELS per SIMD step.
+  void process(const SampleType* const* audioIn, const SampleType* const* keyIn, SampleType* const* audioOut,
+               int firstChannel, int numChannels, int numSamplesToRender);
+  void process(const SampleType* const* audioIn, const SampleType* const* keyIn, SampleType* const* audioOut,
+               const int numChannels, const int numSamplesToRender)
+  {
+    process(audioIn, keyIn, audioOut, 0, numChannels, numSamplesToRender);
+  }
+
+  SampleType applyRMSCompression(SampleType sample);
 
  private:
+  // Samples per pass through the gain computer stages, a multiple of every SIMD width
+  static constexpr int CHUNK_SIZE = 64;
+  // Gain curve table points spanning MINUS_INF_DB..0 dB
+  static constexpr int CURVE_TABLE_SIZE = 1024;
+  // Unlinked channels smoothed together, one per lane of an 8-float register
+  static constexpr int PARALLEL_CHANNELS = 8;
+
+  struct ChannelState
+  {
+    float prevGainSmooth  = 0.0f;
+    float prevLevelSmooth = 0.0f;  // dB, Detector::LogPeak
+    SampleType feedback   = 0;     // last output sample, Topology::FeedBack
+
+    // Control rate: position in the current interval, its running sum and the linear gain ramp
+    int controlPhase   = 0;
+    float controlLevel = 0.0f;
+    float controlGain  = 1.0f;
+    float controlStep  = 0.0f;
+
+    // Lookahead delay line and the monotonic deque of (position, level) for the sliding maximum. Both are
+    // power-of-two rings indexed by free-running counters, so wrap-around is a mask.
+    std::vector<SampleType> delay;
+    std::vector<float> peakLevels;
+    std::vector<uint32_t> peakPositions;
+    uint32_t position = 0;
+    uint32_t peakHead = 0;
+    uint32_t peakTail = 0;
+
+    // Squared input history for the windowed RMS, with its running sum
+    std::vector<float> squares;
+    uint32_t rmsPosition = 0;
+    float rmsSum         = 0.0f;
+
+    SampleType keyState = 0;  // key filter integrator
+
+    // Threshold, slope and knee width heading for the active curve, stepped per channel so every channel sees the
+    // same ramp
+    APParameterRamp threshold;
+    APParameterRamp slope;
+    APParameterRamp kneeWidth;
+
+    bool isCurveRamping() const { return threshold.isRamping() || slope.isRamping() || kneeWidth.isRamping(); }
+    // Moves the ramps on over samples whose gain change is never computed
+    void skipCurve(const int numSamples)
+    {
+      threshold.skip(numSamples);
+      slope.skip(numSamples);
+      kneeWidth.skip(numSamples);
+    }
+    void clear();
+    // Takes the detector, smoother and curve ramps of from, the channel a linked group ran on. The delay line,
+    // feedback sample and key filter stay this channel's own.
+    void follow(const ChannelState& from);
+
+    bool relinked = false;  // the link mode changed since this channel last ran in a group
+  };
+
+  struct GainCurve
+  {
+    float threshold = 0.0f;
+    float kneeLow   = 0.0f;  // threshold - kneeWidth / 2
+    float kneeHigh  = 0.0f;  // threshold + kneeWidth / 2
+    float kneeWidth = 0.0f;
+    float slope     = 0.0f;  // 1 / ratio - 1
+    float kneeScale = 0.0f;  // slope / (2 * kneeWidth)
+
+    bool useTable = false;
+    std::array<float, CURVE_TABLE_SIZE + 1> table {};  // gain change (dB)
+
+    // Soft knee written as slope * (clamp(x - kneeLow, 0, W)^2 / 2W + max(x - kneeHigh, 0)), no branches
+    float gainChangeDb(float xDb) const;
+  };
+
+  void updateSmoothingCoefficients();
+  // Stores the curve settings and publishes them if any changed. Callers hold writerMutex_, so the settings it
+  // keeps are read and written as one set.
+  void setCurve(float threshold, float ratio, float kneeWidth);
+  // Rebuilds the free curve slot from the current settings and publishes it to the audio thread
+  void publishCurve();
+
+  // The channels of one kernel call: one, or a linked group on the detector of channels_[first]
+  struct Channels
+  {
+    const SampleType* const* audioIn;
+    const SampleType* const* keyIn;  // null: the detector reads audioIn
+    SampleType* const* audioOut;
+    int first;
+    int count;
+  };
+
+  // Picks up a newly published curve, ramping or snapping every channel towards it
+  void updateActiveCurve();
+
+  using Kernel = void (APCompressor::*)(const GainCurve&, const Channels&, int);
+  // One processChannel instantiation per model, indexed as documented in selectKernel
+  template <size_t... Index>
+  static constexpr std::array<Kernel, sizeof...(Index)> makeKernels(std::index_sequence<Index...>);
+  Kernel selectKernel(const GainCurve& curve, bool externalKey) const;
+
+  template <typename Model>
+  void processChannel(const GainCurve& curve, const Channels& channels, int numSamples);
+  // Unlinked channels: every stage but the smoother runs per channel, the smoother runs across the channels
+  // (structure of arrays in lanes_), so its recursion costs one step per sample for up to PARALLEL_CHANNELS
+  // channels. Feedback, control rate and channels at unity run channel by channel.
+  template <typename Model>
+  void processParallel(const GainCurve& curve, const Channels& channels, int numSamples);
+  // Topology::FeedBack: the detector needs the previous output, so the whole chain runs sample by sample. Link mode
+  // and key filter are template parameters, picked in processChannel, so the sample loop has no dispatch left.
+  template <typename Model, ChannelLink link, bool keyFiltered>
+  void processFeedback(const GainCurve& curve, const Channels& channels, int numSamples);
+  // True when the curve is 1:1 and settled and the smoother has released, so the output is the delayed input.
+  // Snaps the residual smoother state to exactly 0 dB when it returns true.
+  bool isUnity(const GainCurve& curve, ChannelState& state) const;
+  // Key for the chunk at offset start: the (filtered) key of a single channel, or the linked key of the group
+  // in linked_
+  const SampleType* linkKeys(const Channels& channels, int start, int numSamples);
+  // High-pass on the key into key_, only called when the key filter is enabled
+  const SampleType* filterKey(ChannelState& state, const SampleType* keyIn, int numSamples);
+  // |key| into gain_
+  void detectPeak(const SampleType* keyIn, int numSamples);
+  // Mean square over the RMS window, written to gain_. O(1) per sample.
+  void detectWindowedRMS(ChannelState& state, const SampleType* audioIn, int numSamples);
+  // Sliding maximum of the level in gain_ over the lookahead window, in place. O(1) amortised per sample.
+  void detectPeakWindow(ChannelState& state, int numSamples);
+  // Writes the input to the delay line and the chunk delayed by the lookahead to audioOut, which may be audioIn
+  void delayChunk(ChannelState& state, const SampleType* audioIn, SampleType* audioOut, int numSamples);
+  // Level in gain_ -> dB, in place
+  template <typename Level>
+  void toDecibels(int numSamples);
+  // Level (dB) in gain_ -> static curve -> gain change (dB), in place
+  template <typename Knee>
+  void computeGainChangeDb(const GainCurve& curve, ChannelState& state, int numSamples);
+  // The analytic curve with per-sample threshold, slope and knee width, used while any of them ramps
+  void computeRampedGainChangeDb(ChannelState& state, int numSamples);
+  // The knee width ramp into kneeRamp_ and its 1 / (2 * width), 0 for a hard knee, into invTwoWidthRamp_
+  void fillKneeRamp(ChannelState& state, int numSamples);
+  // Attack/release smoothing of gain_ in place, of the level before the curve or the gain change after it.
+  // The only serial stage.
+  template <typename Model>
+  void smoothLevel(ChannelState& state, int numSamples);
+  template <typename Model>
+  void smoothGainChange(ChannelState& state, int numSamples);
+  // smoothLevel or smoothGainChange on every lane of lanes_ at once, prev holding each lane's smoother state
+  template <typename Model>
+  void smoothLanes(float* prev, int numSamples);
+  // Gain change (dB) in gain_ -> linear, in place
+  void toLinearGain(int numSamples);
+  // Control rate replacement for the smoother and dB -> linear stage: gain_ (level or gain change, dB) ->
+  // interval mean -> smoother (and curve, log domain) once per interval -> interpolated linear gain in gain_
+  template <typename Model>
+  void computeControlRateGain(ChannelState& state, int numSamples);
+  // Linear gain in gain_ times every channel's (delayed) input, or the plain (delayed) input when unity
+  void applyGain(const Channels& channels, int start, int numSamples, bool unity);
+
   float sampleRate_     = 0.0f;
   float threshold_      = 0.0f;
   float ratio_          = 1.0f;
   float attack_         = 0.02f;  // 50 ms
   float release_        = 0.08f;  // 80 ms
   float kneeWidth_      = 6.0f;
-  float prevGainSmooth_ = 0.0f;
+  float lookahead_      = 0.0f;
+  float rmsWindow_      = 0.01f;  // 10 ms
+  CurveMode curveMode_  = CurveMode::Analytic;
+  Detector detector_    = Detector::ApproxRMS;
+  Topology topology_    = Topology::FeedForward;
+  Character character_  = Character::VCA;
+  int controlInterval_  = 1;
+  ChannelLink link_     = ChannelLink::Off;
+
+  bool keyFilterEnabled_    = false;
+  float keyFilterFrequency_ = 100.0f;
+  float keyFilterGain_      = 0.0f;  // g / (1 + g) of the one-pole TPT, g = tan(pi f / fs)
+
+  std::vector<ChannelState> channels_ = std::vector<ChannelState>(1);
+  int lookaheadSamples_ = 0;
+  int rmsWindowSamples_ = 1;
+
+  // Cached coefficients
+  SmoothingCoefficients alpha_;
+  SmoothingCoefficients controlAlpha_;  // alpha_ to the power of controlInterval_
+
+  // Double-buffered static curve. The writer fills whichever slot the audio thread is not reading and parks it in
+  // pendingCurve_; process() swaps it in with a single exchange at the start of the block.
+  std::array<GainCurve, 2> curves_;
+  std::atomic<GainCurve*> pendingCurve_ { nullptr };
+  GainCurve* activeCurve_   = nullptr;  // audio thread only
+  bool snapCurve_           = true;     // audio thread only, the first curve after reset() applies without a ramp
+  GainCurve* lastPublished_ = nullptr;  // writer only
+  std::mutex writerMutex_;              // serialises writers, never taken by the audio thread
+
+  alignas(32) std::array<float, CHUNK_SIZE> gain_ {};
+  alignas(32) std::array<SampleType, CHUNK_SIZE> linked_ {};
+  alignas(32) std::array<SampleType, CHUNK_SIZE> key_ {};
+  alignas(32) std::array<float, CHUNK_SIZE> thresholdRamp_ {};
+  alignas(32) std::array<float, CHUNK_SIZE> slopeRamp_ {};
+  alignas(32) std::array<float, CHUNK_SIZE> kneeRamp_ {};
+  alignas(32) std::array<float, CHUNK_SIZE> invTwoWidthRamp_ {};
+  alignas(32) std::array<float, CHUNK_SIZE * PARALLEL_CHANNELS> lanes_ {};  // [sample][channel]
 };
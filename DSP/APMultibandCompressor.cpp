@@ -0,0 +1,336 @@
+/*
+  ==============================================================================
+
+    APMultibandCompressor.cpp
+    Created: 17 Oct 2026 10:31:07am
+
+  ==============================================================================
+*/
+
+#include "APMultibandCompressor.h"
+
+#include "../Helpers/APDefines.h"
+#include "../Helpers/APMath.h"
+#include "APCompressor.h"
+
+#include <algorithm>
+
+namespace
+{
+  const auto minusInfGain = juce::Decibels::decibelsToGain(APConstants::Math::MINUS_INF_DB, -200.0f);
+
+  enum class Response
+  {
+    LowPass,
+    HighPass,
+    AllPass,
+    Identity,
+    Mute,
+  };
+
+  struct Coefficients
+  {
+    double b0, b1, b2, a1, a2;
+  };
+
+  // Second order Butterworth sections (Q = 1 / sqrt(2)). Two low or high passes in series make an LR4 low or high
+  // pass, and the pair sums to the all pass with the same poles, so a band that has to stay phase aligned with a
+  // split it does not take part in only needs one biquad.
+  Coefficients butterworth(const Response response, const double frequency, const double sampleRate)
+  {
+    const auto w0    = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+    const auto cosw0 = std::cos(w0);
+    const auto alpha = std::sin(w0) / juce::MathConstants<double>::sqrt2;
+    const auto a0    = 1.0 + alpha;
+
+    switch (response)
+    {
+      case Response::LowPass:
+        return { (1.0 - cosw0) / (2.0 * a0), (1.0 - cosw0) / a0, (1.0 - cosw0) / (2.0 * a0), -2.0 * cosw0 / a0,
+                 (1.0 - alpha) / a0 };
+      case Response::HighPass:
+        return { (1.0 + cosw0) / (2.0 * a0), -(1.0 + cosw0) / a0, (1.0 + cosw0) / (2.0 * a0), -2.0 * cosw0 / a0,
+                 (1.0 - alpha) / a0 };
+      case Response::AllPass:
+        return { (1.0 - alpha) / a0, -2.0 * cosw0 / a0, 1.0, -2.0 * cosw0 / a0, (1.0 - alpha) / a0 };
+      case Response::Identity:
+        return { 1.0, 0.0, 0.0, 0.0, 0.0 };
+      case Response::Mute:
+        break;
+    }
+    return { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  }
+}  // namespace
+
+APMultibandCompressor::APMultibandCompressor()
+{
+  updateParameters(0.0f, 1.0f, 6.0f);
+  updateCrossovers();
+  updateSmoothingCoefficients();
+  reset();
+}
+
+APMultibandCompressor::~APMultibandCompressor() = default;
+
+void APMultibandCompressor::prepare(const float sampleRate, const int numChannels)
+{
+  sampleRate_ = sampleRate;
+  rampLength_ =
+      juce::jmax(1, juce::roundToInt(static_cast<double>(sampleRate) * APConstants::Math::PARAMETER_RAMP_TIME));
+  channels_.resize(static_cast<size_t>(juce::jmax(1, numChannels)));
+  updateCrossovers();
+  updateSmoothingCoefficients();
+  reset();
+}
+
+void APMultibandCompressor::reset()
+{
+  snapCurve_ = true;
+  for (auto& state : channels_)
+  {
+    state.clear();
+    state.curve         = target_;
+    state.rampRemaining = 0;
+  }
+}
+
+void APMultibandCompressor::ChannelState::clear()
+{
+  s1.fill(SIMD::expand(0.0f));
+  s2.fill(SIMD::expand(0.0f));
+  gainSmooth = SIMD::expand(0.0f);
+}
+
+void APMultibandCompressor::setNumBands(const int numBands)
+{
+  const auto bands = juce::jlimit(2, MAX_BANDS, numBands);
+  if (bands == numBands_)
+    return;
+
+  numBands_ = bands;
+  updateCrossovers();
+  reset();  // the band layout changed under the filter state
+}
+
+void APMultibandCompressor::setCrossovers(const float low, const float mid, const float high)
+{
+  std::array<float, MAX_BANDS - 1> crossovers { low, mid, high };
+  std::sort(crossovers.begin(), crossovers.end());
+  if (crossovers == crossovers_)
+    return;
+
+  crossovers_ = crossovers;
+  updateCrossovers();
+}
+
+void APMultibandCompressor::setAttack(const float attack)
+{
+  attack_ = attack;
+  updateSmoothingCoefficients();
+}
+
+void APMultibandCompressor::setRelease(const float release)
+{
+  release_ = release;
+  updateSmoothingCoefficients();
+}
+
+void APMultibandCompressor::updateParameters(const int band, const float threshold, const float ratio,
+                                             const float kneeWidth)
+{
+  jassert(band >= 0 && band < MAX_BANDS);
+  const auto lane  = static_cast<size_t>(band);
+  const auto width = juce::jmax(0.0f, kneeWidth);
+  const auto slope = 1 / ratio - 1;
+
+  target_.kneeLow.set(lane, threshold - width / 2);
+  target_.kneeHigh.set(lane, threshold + width / 2);
+  target_.kneeWidth.set(lane, width);
+  target_.kneeScale.set(lane, width > 0.0f ? slope / (2 * width) : 0.0f);
+  target_.slope.set(lane, slope);
+
+  const auto perSample = 1.0f / static_cast<float>(rampLength_);
+  for (auto& state : channels_)
+  {
+    if (snapCurve_)
+    {
+      state.curve = target_;
+      continue;
+    }
+    state.step.kneeLow   = (target_.kneeLow - state.curve.kneeLow) * perSample;
+    state.step.kneeHigh  = (target_.kneeHigh - state.curve.kneeHigh) * perSample;
+    state.step.kneeWidth = (target_.kneeWidth - state.curve.kneeWidth) * perSample;
+    state.step.kneeScale = (target_.kneeScale - state.curve.kneeScale) * perSample;
+    state.step.slope     = (target_.slope - state.curve.slope) * perSample;
+    state.rampRemaining  = rampLength_;
+  }
+}
+
+void APMultibandCompressor::updateParameters(const float threshold, const float ratio, const float kneeWidth)
+{
+  // Lanes past MAX_BANDS carry silence and keep the flat curve they were zero-initialised with
+  for (int band = 0; band < MAX_BANDS; ++band)
+    updateParameters(band, threshold, ratio, kneeWidth);
+}
+
+void APMultibandCompressor::updateSmoothingCoefficients()
+{
+  alphaA_ = SIMD::expand(APCompressorBase::smoothingCoefficient(sampleRate_, attack_));
+  alphaR_ = SIMD::expand(APCompressorBase::smoothingCoefficient(sampleRate_, release_));
+}
+
+void APMultibandCompressor::updateCrossovers()
+{
+  if (sampleRate_ <= 0.0f)
+    return;
+
+  // Band b is low passed by split b, high passed by every split below it and all passed by every split above it,
+  // so the bands sum to an all pass. Splits past the band count pass everything through.
+  const auto sampleRate = static_cast<double>(sampleRate_);
+  for (int split = 0; split < MAX_BANDS - 1; ++split)
+  {
+    const auto frequency =
+        juce::jlimit(10.0, 0.45 * sampleRate, static_cast<double>(crossovers_[static_cast<size_t>(split)]));
+
+    const auto setLane = [&](const int biquad, const size_t lane, const Response response) {
+      const auto c = butterworth(response, frequency, sampleRate);
+      auto& f      = biquads_[static_cast<size_t>(biquad)];
+      f.b0.set(lane, static_cast<float>(c.b0));
+      f.b1.set(lane, static_cast<float>(c.b1));
+      f.b2.set(lane, static_cast<float>(c.b2));
+      f.a1.set(lane, static_cast<float>(c.a1));
+      f.a2.set(lane, static_cast<float>(c.a2));
+    };
+
+    for (int band = 0; band < LANES; ++band)
+    {
+      auto first  = Response::Identity;
+      auto second = Response::Identity;
+      if (band >= numBands_)
+        first = split == 0 ? Response::Mute : Response::Identity;
+      else if (split >= numBands_ - 1)
+        first = second = Response::Identity;
+      else if (band < split)
+        first = Response::AllPass;
+      else if (band == split)
+        first = second = Response::LowPass;
+      else
+        first = second = Response::HighPass;
+
+      setLane(2 * split, static_cast<size_t>(band), first);
+      setLane(2 * split + 1, static_cast<size_t>(band), second);
+    }
+  }
+}
+
+void APMultibandCompressor::process(const int channel, const float* audioIn, float* audioOut,
+                                    const int numSamplesToRender)
+{
+  jassert(channel >= 0 && channel < static_cast<int>(channels_.size()));
+  auto& state = channels_[static_cast<size_t>(channel)];
+
+  snapCurve_ = false;
+
+  for (int start = 0; start < numSamplesToRender; start += CHUNK_SIZE)
+  {
+    const auto numSamples = juce::jmin(CHUNK_SIZE, numSamplesToRender - start);
+    splitBands(state, audioIn + start, numSamples);  // serial in time, parallel across bands
+    computeBandGains(state, numSamples);
+    recombine(audioOut + start, numSamples);
+  }
+}
+
+void APMultibandCompressor::splitBands(ChannelState& state, const float* audioIn, const int numSamples)
+{
+  // Every lane sees the same input and runs its own cascade, so the whole split is one pass of 2 * (bands - 1)
+  // vector biquads per sample
+  const auto numBiquads = 2 * (numBands_ - 1);
+  auto s1               = state.s1;
+  auto s2               = state.s2;
+  auto* bands           = bands_.data();
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    auto x = SIMD::expand(audioIn[i]);
+    for (int k = 0; k < numBiquads; ++k)
+    {
+      const auto& f = biquads_[static_cast<size_t>(k)];
+      auto& z1      = s1[static_cast<size_t>(k)];
+      auto& z2      = s2[static_cast<size_t>(k)];
+      const auto y  = f.b0 * x + z1;
+      z1            = f.b1 * x - f.a1 * y + z2;
+      z2            = f.b2 * x - f.a2 * y;
+      x             = y;
+    }
+    x.copyToRawArray(bands + i * LANES);
+  }
+
+  state.s1 = s1;
+  state.s2 = s2;
+}
+
+void APMultibandCompressor::computeBandGains(ChannelState& state, const int numSamples)
+{
+  const auto count = numSamples * LANES;
+  auto* gain       = gain_.data();
+
+  // Level to dB over every band at once, the same vectorised path as APCompressor
+  juce::FloatVectorOperations::abs(gain, bands_.data(), count);
+  juce::FloatVectorOperations::max(gain, gain, minusInfGain, count);
+  APMath::gainToDecibels(gain, gain, count);
+
+  // Only the frames still inside a curve ramp pay for stepping it
+  const auto rampFrames = juce::jmin(numSamples, state.rampRemaining);
+  if (rampFrames > 0)
+    smoothBandGains<true>(state, 0, rampFrames);
+  smoothBandGains<false>(state, rampFrames, numSamples);
+
+  APMath::decibelsToGain(gain, gain, count);
+}
+
+template <bool Ramping>
+void APMultibandCompressor::smoothBandGains(ChannelState& state, const int begin, const int end)
+{
+  // One frame (every band at one sample) per step. The smoother is recursive in time but independent across bands,
+  // so it fills the lanes that a single band would leave idle.
+  const auto zero = SIMD::expand(0.0f);
+  auto curve      = state.curve;
+  auto smooth     = state.gainSmooth;
+  auto* gain      = gain_.data();
+
+  for (int i = begin; i < end; ++i)
+  {
+    if constexpr (Ramping)
+    {
+      curve.kneeLow   += state.step.kneeLow;
+      curve.kneeHigh  += state.step.kneeHigh;
+      curve.kneeWidth += state.step.kneeWidth;
+      curve.kneeScale += state.step.kneeScale;
+      curve.slope     += state.step.slope;
+    }
+
+    auto* frame             = gain + i * LANES;
+    const auto xDb          = SIMD::fromRawArray(frame);
+    const auto inKnee       = SIMD::min(SIMD::max(xDb - curve.kneeLow, zero), curve.kneeWidth);
+    const auto above        = SIMD::max(xDb - curve.kneeHigh, zero);
+    const auto gainChangeDb = curve.kneeScale * inKnee * inKnee + curve.slope * above;
+    const auto alpha        = alphaR_ + ((alphaA_ - alphaR_) & SIMD::lessThan(gainChangeDb, smooth));
+    smooth                  = gainChangeDb + alpha * (smooth - gainChangeDb);
+    smooth.copyToRawArray(frame);
+  }
+
+  state.gainSmooth = smooth;
+  if constexpr (Ramping)
+  {
+    state.rampRemaining -= end - begin;
+    state.curve = state.rampRemaining > 0 ? curve : target_;  // land exactly on the target
+  }
+}
+
+void APMultibandCompressor::recombine(float* audioOut, const int numSamples)
+{
+  const auto* bands = bands_.data();
+  const auto* gain  = gain_.data();
+  for (int i = 0; i < numSamples; ++i)
+    audioOut[i] = (SIMD::fromRawArray(bands + i * LANES) * SIMD::fromRawArray(gain + i * LANES)).sum();
+}
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    APMultibandCompressor.h
+    Created: 17 Oct 2026 10:31:07am
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+
+#include <array>
+#include <vector>
+
+// Splits the signal into up to MAX_BANDS bands with 4th order Linkwitz-Riley crossovers and compresses each band
+// with its own detector. One band lives in each SIMD lane, so the crossovers, the gain computer, the smoothing and
+// the recombination all run once per sample for every band together rather than once per band.
+class APMultibandCompressor
+{
+ public:
+  static constexpr int MAX_BANDS = 4;
+
+  APMultibandCompressor();
+  ~APMultibandCompressor();
+
+  // Allocates per-channel filter and detector state. Not real-time safe.
+  void prepare(float sampleRate, int numChannels);
+  // 2 to MAX_BANDS bands. The first numBands - 1 crossover frequencies are used.
+  void setNumBands(int numBands);
+  int getNumBands() const { return numBands_; }
+  // Crossover frequencies in Hz, sorted and kept below Nyquist
+  void setCrossovers(float low, float mid, float high);
+  // Time constants in seconds, shared by every band
+  void setAttack(float attack);
+  void setRelease(float release);
+  // Static curve for one band, or every band. Changes ramp in over APConstants::Math::PARAMETER_RAMP_TIME.
+  void updateParameters(int band, float threshold, float ratio, float kneeWidth);
+  void updateParameters(float threshold, float ratio, float kneeWidth);
+  void reset();
+
+  void process(int channel, const float* audioIn, float* audioOut, int numSamplesToRender);
+
+ private:
+  using SIMD = juce::dsp::SIMDRegister<float>;
+  static constexpr int LANES = static_cast<int>(SIMD::SIMDNumElements);
+  static_assert(LANES >= MAX_BANDS, "one band per SIMD lane");
+
+  static constexpr int CHUNK_SIZE  = 64;
+  // Each of the MAX_BANDS - 1 splits is an LR4 section, built from two biquads
+  static constexpr int NUM_BIQUADS = 2 * (MAX_BANDS - 1);
+
+  // Transposed direct form II biquad, with its own coefficients in every lane
+  struct Biquad
+  {
+    SIMD b0, b1, b2, a1, a2;
+  };
+
+  // Per-lane static curve, same shape as APCompressor::GainCurve
+  struct Curve
+  {
+    SIMD kneeLow, kneeHigh, kneeWidth, kneeScale, slope;
+  };
+
+  struct ChannelState
+  {
+    std::array<SIMD, NUM_BIQUADS> s1, s2;
+    SIMD gainSmooth;  // smoothed gain change (dB) per band
+
+    // Curve in use, stepping towards target_ while rampRemaining > 0
+    Curve curve, step;
+    int rampRemaining = 0;
+
+    void clear();
+  };
+
+  // Rebuilds the per-lane biquad coefficients from the band count and crossover frequencies
+  void updateCrossovers();
+  void updateSmoothingCoefficients();
+
+  // Band split of the input, one frame of LANES band samples per input sample, into bands_
+  void splitBands(ChannelState& state, const float* audioIn, int numSamples);
+  // bands_ -> level (dB) -> static curve -> smoothed gain change -> linear gain, into gain_
+  void computeBandGains(ChannelState& state, int numSamples);
+  // Static curve and attack/release over frames [begin, end) of gain_, with the curve stepping per frame if ramping
+  template <bool Ramping>
+  void smoothBandGains(ChannelState& state, int begin, int end);
+  // Sum of every band times its gain
+  void recombine(float* audioOut, int numSamples);
+
+  float sampleRate_ = 0.0f;
+  int numBands_     = 3;
+  std::array<float, MAX_BANDS - 1> crossovers_ { 120.0f, 1000.0f, 6000.0f };
+  float attack_  = 0.02f;
+  float release_ = 0.08f;
+
+  std::array<Biquad, NUM_BIQUADS> biquads_ {};
+
+  Curve target_ {};
+  int rampLength_ = 1;
+  bool snapCurve_ = true;  // curve changes before the first block after reset() apply without a ramp
+  SIMD alphaA_ {}, alphaR_ {};
+
+  std::vector<ChannelState> channels_ = std::vector<ChannelState>(1);
+
+  alignas(32) std::array<float, CHUNK_SIZE * LANES> bands_ {};
+  alignas(32) std::array<float, CHUNK_SIZE * LANES> gain_ {};
+};
@@ -12,73 +12,343 @@
 
 #include <juce_core/juce_core.h>
 
-APOverdrive::APOverdrive() = default;
+#include <algorithm>
+#include <array>
+#include <cmath>
 
-APOverdrive::~APOverdrive() = default;
+#include "../Helpers/APMath.h"
 
-void APOverdrive::process(const float* audioIn, float* audioOut, const int numSamplesToRender) const
+namespace
 {
-  for (auto i = 0; i < numSamplesToRender; ++i)
+  // The clipping curves, inline so the region loops vectorise with them. Both are selects over polynomials, with no
+  // calls and no branches.
+  template <typename SampleType>
+  inline SampleType softCurve(const SampleType sample)
   {
-    const auto& sample = audioIn[i];
-    const auto out     = [&]()
-    {
-      float result = 0.0f;
-      if (mix_ >= 0.0f && mix_ <= 0.3f)
-      {  // No Clipping
-        result = sample;
-      }
-      if (mix_ > 0.3f && mix_ < 0.34f)
-      {
-        result = mix_ * softClipping(sample) + (1 - mix_) * sample;
-      }
-      if (mix_ >= 0.34f && mix_ <= 0.6f)
-      {  // Soft Clipping
-        // Dirtier
-        result = softClipping(sample);
-        result = mix_ * result + (1.0f - mix_) * sample;
-      }
-      if (mix_ > 0.6f && mix_ < 0.64f)
-      {
-        result = mix_ * softClipping(sample) + (1.0f - mix_) * hardClipping(sample);
-      }
-      if (mix_ >= 0.64f && mix_ <= 1.0f)
-      {  // Hard Clipping
-        // Dirty
-        result = hardClipping(sample);
-        result = mix_ * result + (1.0f - mix_) * softClipping(sample);
-      }
-      return result;
-    }();
-    audioOut[i] = out;
+    return SampleType(2 / APMath::pi) * static_cast<SampleType>(APMath::fastAtan(static_cast<float>(5 * sample)));
+  }
+
+  template <typename SampleType>
+  inline SampleType hardCurve(const SampleType sample)
+  {
+    const auto xUni = std::abs(sample);
+    const auto sine = static_cast<SampleType>(APMath::fastSin(static_cast<float>(sample)));
+    const auto edge = 2 - 3 * xUni;
+    const auto knee = sine * (3 - edge * edge) * SampleType(0.33333);
+    return xUni <= SampleType(1) / 3 ? 2 * sample : (xUni > SampleType(2) / 3 ? sine : knee);
+  }
+
+  // Means of the curves between two samples, for the anti-aliased kernels. Each is written so that nothing cancels
+  // as the samples meet: the plain difference of antiderivatives over their distance loses every digit there.
+
+  // sin(h) / h
+  inline float sinc(const float h)
+  {
+    const auto ratio = APMath::fastSin(h) / h;
+    return h == 0.0f ? 1.0f : ratio;
+  }
+
+  // In units of a = 5x the soft curve is (2/pi) atan(a), with antiderivative a atan(a) - ln(1 + a^2) / 2. The
+  // differences of atans and of logs between a and b each reduce to one function of an argument proportional to
+  // a - b, which leaves the mean as
+  //   atan(a) + b g(u) / (1 + ab) - (a + b) h(w - 1) / (2 (1 + b^2))
+  // with u = (a - b) / (1 + ab), w = (1 + a^2) / (1 + b^2), g(u) = atan(u) / u and h(v) = ln(1 + v) / v. The atan
+  // identity needs 1 + ab > 0; past that the samples are at least 0.4 apart and the plain difference is safe.
+  template <typename SampleType>
+  inline SampleType softMean(const SampleType sample, const SampleType previous)
+  {
+    const auto a       = 5.0f * static_cast<float>(sample);
+    const auto b       = 5.0f * static_cast<float>(previous);
+    const auto atanA   = APMath::fastAtan(a);
+    const auto cross   = 1.0f + a * b;
+    const auto squareB = 1.0f + b * b;
+    const auto w       = (1.0f + a * a) / squareB;
+    const auto logW    = APMath::fastLog(w);
+
+    const auto u     = (a - b) / cross;
+    const auto atanU = APMath::fastAtan(u) / u;
+    const auto g     = u == 0.0f ? 1.0f : atanU;
+    const auto logV  = logW / (w - 1.0f);
+    const auto h     = w == 1.0f ? 1.0f : logV;
+    const auto close = atanA + b * g / cross - (a + b) * h / (2.0f * squareB);
+    const auto apart = (a * atanA - b * APMath::fastAtan(b) - 0.5f * logW) / (a - b);
+    return SampleType(2 / APMath::pi) * static_cast<SampleType>(cross > 0.0f ? close : apart);
+  }
+
+  // The hard curve is odd, so its antiderivative is even and the mean between x1 and x is
+  // (F(|x|) - F(|x1|)) / (x - x1): the mean over the magnitudes, times (|x| - |x1|) / (x - x1). The magnitudes'
+  // interval splits at the corners into pieces on the line, the knee and the sine, each with its own closed form
+  // mean, weighted by the lengths of the pieces. Knee and sine come from sin(q) - sin(p) = 2 cos(m) sin(d/2) and
+  // cos(q) - cos(p) = -2 sin(m) sin(d/2), with m and d the middle and width of the piece.
+  inline float hardKneeMean(const float p, const float q)
+  {
+    // The knee is c sin(s) P(s) with P(s) = 3 - (2 - 3s)^2 and c = 0.33333, whose antiderivative is
+    // c (sin(s) P'(s) - cos(s) (P(s) - P''(s))), P'(s) = 12 - 18s, P(s) - P''(s) = 17 + 12s - 9s^2. Everything
+    // here lies in [0, pi/2], where the sine's polynomial needs no range reduction.
+    constexpr auto halfPi = static_cast<float>(APMath::pi / 2);
+    const auto middle     = 0.5f * (p + q);
+    const auto halfWidth  = 0.5f * (q - p);
+    const auto ratio      = APMath::Detail::reducedSin(halfWidth) / halfWidth;
+    const auto shape      = halfWidth == 0.0f ? 1.0f : ratio;
+    const auto sinMiddle  = APMath::Detail::reducedSin(middle);
+    const auto cosMiddle  = APMath::Detail::reducedSin(halfPi - middle);
+    const auto sinP       = APMath::Detail::reducedSin(p);
+    const auto cosP       = APMath::Detail::reducedSin(halfPi - p);
+    return 0.33333f * ((12.0f - 18.0f * q) * cosMiddle * shape - 18.0f * sinP +
+                       (17.0f + q * (12.0f - 9.0f * q)) * sinMiddle * shape - cosP * (12.0f - 9.0f * (p + q)));
+  }
+
+  template <typename SampleType>
+  inline SampleType hardMean(const SampleType sample, const SampleType previous)
+  {
+    constexpr auto third     = 1.0f / 3.0f;
+    constexpr auto twoThirds = 2.0f / 3.0f;
+
+    const auto magnitude = static_cast<float>(std::abs(sample));
+    const auto before    = static_cast<float>(std::abs(previous));
+    const auto low       = juce::jmin(magnitude, before);
+    const auto high      = juce::jmax(magnitude, before);
+
+    const auto lineLow  = juce::jmin(low, third);
+    const auto lineHigh = juce::jmin(high, third);
+    const auto kneeLow  = juce::jlimit(third, twoThirds, low);
+    const auto kneeHigh = juce::jlimit(third, twoThirds, high);
+    const auto sineLow  = juce::jmax(low, twoThirds);
+    const auto sineHigh = juce::jmax(high, twoThirds);
+
+    const auto line   = lineLow + lineHigh;
+    const auto knee   = hardKneeMean(kneeLow, kneeHigh);
+    const auto sine   = APMath::fastSin(0.5f * (sineLow + sineHigh)) * sinc(0.5f * (sineHigh - sineLow));
+    const auto pieces = ((lineHigh - lineLow) * line + (kneeHigh - kneeLow) * knee + (sineHigh - sineLow) * sine) /
+                        (high - low);
+    // With no width the piece holding the point has the curve's value there
+    const auto point          = high <= third ? line : (high > twoThirds ? sine : knee);
+    const auto overMagnitudes = high > low ? pieces : point;
+
+    // Exactly +-1 for samples of one sign, which covers sample == previous
+    const auto distance = static_cast<float>(sample - previous);
+    const auto ratio    = (magnitude - before) / distance;
+    const auto sign     = distance != 0.0f ? ratio : (sample < 0 ? -1.0f : 1.0f);
+    return static_cast<SampleType>(sign * overMagnitudes);
+  }
+}  // namespace
+
+template <typename SampleType>
+APOverdrive<SampleType>::APOverdrive() = default;
+
+template <typename SampleType>
+APOverdrive<SampleType>::~APOverdrive() = default;
+
+template <typename SampleType>
+void APOverdrive<SampleType>::prepare(const int numChannels)
+{
+  fadeRemaining_.assign(static_cast<size_t>(juce::jmax(1, numChannels)), 0);
+  previous_.assign(fadeRemaining_.size(), SampleType(0));
+}
+
+template <typename SampleType>
+void APOverdrive<SampleType>::reset()
+{
+  std::fill(fadeRemaining_.begin(), fadeRemaining_.end(), 0);
+  std::fill(previous_.begin(), previous_.end(), SampleType(0));
+}
+
+template <typename SampleType>
+void APOverdrive<SampleType>::updateParameters(const float mix, const bool antialiased)
+{
+  const auto region = regionOf(mix);
+  if (region != region_ || antialiased != antialiased_)
+  {
+    // A fade already under way restarts from the kernel that was current
+    fadeRegion_      = region_;
+    fadeMix_         = mix_;
+    fadeAntialiased_ = antialiased_;
+    std::fill(fadeRemaining_.begin(), fadeRemaining_.end(), CROSSFADE_SAMPLES);
   }
+  mix_         = mix;
+  region_      = region;
+  antialiased_ = antialiased;
 }
 
-float APOverdrive::softClipping(const float sample)
+template <typename SampleType>
+typename APOverdrive<SampleType>::Region APOverdrive<SampleType>::regionOf(const float mix)
 {
-  const auto alpha = 5.0f;
-  return (2.0f / juce::float_Pi) * atan(alpha * sample);
+  if (mix >= 0.0f && mix <= 0.3f)
+    return Region::Clean;  // No Clipping
+  if (mix > 0.3f && mix <= 0.6f)
+    return Region::Soft;  // Soft Clipping, dirtier
+  if (mix > 0.6f && mix < 0.64f)
+    return Region::SoftHard;
+  if (mix >= 0.64f && mix < 1.0f)
+    return Region::HardSoft;  // Hard Clipping, dirty
+  if (mix == 1.0f)
+    return Region::Hard;
+  return Region::Off;
 }
-float APOverdrive::hardClipping(const float sample)
+
+template <typename SampleType>
+template <typename APOverdrive<SampleType>::Region region, bool antialiased, typename Mix>
+void APOverdrive<SampleType>::processKernel(const Mix mix, SampleType previous, const SampleType* audioIn,
+                                            SampleType* audioOut, const int numSamples)
 {
-  const auto xUni = abs(sample);
-  const auto out  = [&]()
+  if constexpr (!antialiased)
   {
-    float result;
-    if (xUni <= 1.0f / 3.0f)
+    juce::ignoreUnused(previous);
+    for (auto i = 0; i < numSamples; ++i)
     {
-      result = 2.0f * sample;
+      const auto sample = audioIn[i];
+      const auto weight = mixAt(mix, i);
+      const auto wet    = static_cast<SampleType>(weight);
+      const auto dry    = static_cast<SampleType>(1.0f - weight);
+      if constexpr (region == Region::Clean)
+        audioOut[i] = sample;
+      else if constexpr (region == Region::Soft)
+        audioOut[i] = wet * softCurve(sample) + dry * sample;
+      else if constexpr (region == Region::SoftHard)
+        audioOut[i] = wet * softCurve(sample) + dry * hardCurve(sample);
+      else if constexpr (region == Region::HardSoft)
+        audioOut[i] = wet * hardCurve(sample) + dry * softCurve(sample);
+      else if constexpr (region == Region::Hard)
+        audioOut[i] = hardCurve(sample);
+      else
+        audioOut[i] = SampleType(0);
     }
-    else if (xUni > 2.0f / 3.0f)
+  }
+  else
+  {
+    // The blend is linear, so its mean is the blend of the curves' means. The dry part's mean is the average of the
+    // two samples, which keeps it aligned with the half-sample delay of the clipped part.
+    std::array<SampleType, CHUNK_SIZE + 1> history;
+    for (auto start = 0; start < numSamples; start += CHUNK_SIZE)
     {
-      result = sin(sample);
+      const auto count = juce::jmin(CHUNK_SIZE, numSamples - start);
+      history[0]       = previous;
+      std::copy(audioIn + start, audioIn + start + count, history.begin() + 1);
+      previous = history[static_cast<size_t>(count)];
+
+      auto* out = audioOut + start;
+      for (auto i = 0; i < count; ++i)
+      {
+        const auto sample = history[static_cast<size_t>(i + 1)];
+        const auto before = history[static_cast<size_t>(i)];
+        const auto weight = mixAt(mix, start + i);
+        const auto wet    = static_cast<SampleType>(weight);
+        const auto dry    = static_cast<SampleType>(1.0f - weight);
+        if constexpr (region == Region::Soft)
+          out[i] = wet * softMean(sample, before) + dry * SampleType(0.5) * (sample + before);
+        else if constexpr (region == Region::SoftHard)
+          out[i] = wet * softMean(sample, before) + dry * hardMean(sample, before);
+        else if constexpr (region == Region::HardSoft)
+          out[i] = wet * hardMean(sample, before) + dry * softMean(sample, before);
+        else if constexpr (region == Region::Hard)
+          out[i] = hardMean(sample, before);
+      }
     }
-    else
+  }
+}
+
+template <typename SampleType>
+template <typename Mix>
+void APOverdrive<SampleType>::processRegion(const Region region, const bool antialiased, const Mix mix,
+                                            const SampleType previous, const SampleType* audioIn,
+                                            SampleType* audioOut, const int numSamples)
+{
+  // Clean and silent regions have nothing to alias
+  switch (region)
+  {
+    case Region::Clean:
+      if (audioIn != audioOut)
+        std::copy(audioIn, audioIn + numSamples, audioOut);
+      break;
+    case Region::Soft:
+      if (antialiased)
+        processKernel<Region::Soft, true>(mix, previous, audioIn, audioOut, numSamples);
+      else
+        processKernel<Region::Soft, false>(mix, previous, audioIn, audioOut, numSamples);
+      break;
+    case Region::SoftHard:
+      if (antialiased)
+        processKernel<Region::SoftHard, true>(mix, previous, audioIn, audioOut, numSamples);
+      else
+        processKernel<Region::SoftHard, false>(mix, previous, audioIn, audioOut, numSamples);
+      break;
+    case Region::HardSoft:
+      if (antialiased)
+        processKernel<Region::HardSoft, true>(mix, previous, audioIn, audioOut, numSamples);
+      else
+        processKernel<Region::HardSoft, false>(mix, previous, audioIn, audioOut, numSamples);
+      break;
+    case Region::Hard:
+      if (antialiased)
+        processKernel<Region::Hard, true>(mix, previous, audioIn, audioOut, numSamples);
+      else
+        processKernel<Region::Hard, false>(mix, previous, audioIn, audioOut, numSamples);
+      break;
+    case Region::Off:
+      processKernel<Region::Off, false>(mix, previous, audioIn, audioOut, numSamples);
+      break;
+  }
+}
+
+template <typename SampleType>
+void APOverdrive<SampleType>::process(const int channel, const SampleType* audioIn, SampleType* audioOut,
+                                      const int numSamplesToRender)
+{
+  processBlock(channel, audioIn, mix_, fadeMix_, audioOut, numSamplesToRender);
+}
+
+template <typename SampleType>
+void APOverdrive<SampleType>::process(const int channel, const SampleType* audioIn, const float* mix,
+                                      SampleType* audioOut, const int numSamplesToRender)
+{
+  // The ramp starts from the old mix, so the old kernel follows it too and fades out from where it was
+  processBlock(channel, audioIn, mix, mix, audioOut, numSamplesToRender);
+}
+
+template <typename SampleType>
+template <typename Mix>
+void APOverdrive<SampleType>::processBlock(const int channel, const SampleType* audioIn, const Mix mix,
+                                           const Mix fadeMix, SampleType* audioOut, const int numSamplesToRender)
+{
+  if (numSamplesToRender <= 0)
+    return;
+
+  auto& remaining = fadeRemaining_[static_cast<size_t>(channel)];
+  auto& previous  = previous_[static_cast<size_t>(channel)];
+  const auto fade = juce::jmin(remaining, numSamplesToRender);
+  const auto last = audioIn[numSamplesToRender - 1];
+
+  // The old kernel's output for the head of the fade, taken before an in-place call overwrites the input
+  if (fade > 0)
+    processRegion(fadeRegion_, fadeAntialiased_, fadeMix, previous, audioIn, fadeBuffer_.data(), fade);
+
+  processRegion(region_, antialiased_, mix, previous, audioIn, audioOut, numSamplesToRender);
+  previous = last;
+
+  if (fade > 0)
+  {
+    const auto done  = CROSSFADE_SAMPLES - remaining;
+    const auto* from = fadeBuffer_.data();
+    for (auto i = 0; i < fade; ++i)
     {
-      result = sin(sample) * (3.0f - powf(2.0f - 3.0f * xUni, 2.0f)) * 0.33333f;
+      const auto weight = static_cast<SampleType>(done + i + 1) / static_cast<SampleType>(CROSSFADE_SAMPLES);
+      audioOut[i]       = from[i] + weight * (audioOut[i] - from[i]);
     }
-    return result;
-  }();
+    remaining -= fade;
+  }
+}
 
-  return out;
+template <typename SampleType>
+SampleType APOverdrive<SampleType>::softClipping(const SampleType sample)
+{
+  return softCurve(sample);
 }
+
+template <typename SampleType>
+SampleType APOverdrive<SampleType>::hardClipping(const SampleType sample)
+{
+  return hardCurve(sample);
+}
+
+template class APOverdrive<float>;
+template class APOverdrive<double>;
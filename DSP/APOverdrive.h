@@ -10,19 +10,81 @@
 
 #pragma once
 
+#include <vector>
+
+template <typename SampleType>
 class APOverdrive
 {
  public:
+  // Samples over which a change of blend region fades from the old region's kernel to the new one
+  static constexpr int CROSSFADE_SAMPLES = 128;
+
   APOverdrive();
   ~APOverdrive();
 
-  void updateParameters(const float mix) { mix_ = mix; }
+  // Allocates the per-channel crossfade and anti-aliasing state. Not real-time safe.
+  void prepare(int numChannels);
+  void reset();
+
+  // Picks the kernel for the following blocks. Moving into another blend region, or switching the anti-aliasing,
+  // crossfades every channel. Anti-aliased, each output is the mean of the curve between the input sample and the
+  // one before it (first-order antiderivative anti-aliasing), which delays the signal by half a sample.
+  void updateParameters(float mix, bool antialiased);
 
-  void process(const float* audioIn, float* audioOut, int numSamplesToRender) const;
+  void process(int channel, const SampleType* audioIn, SampleType* audioOut, int numSamplesToRender);
+  // With the blend weights following mix, one value per sample, while it ramps to the value last given to
+  // updateParameters(). The kernel stays the one of that value's region.
+  void process(int channel, const SampleType* audioIn, const float* mix, SampleType* audioOut,
+               int numSamplesToRender);
 
-  static float softClipping(float sample);
-  static float hardClipping(float sample);
+  static SampleType softClipping(SampleType sample);
+  static SampleType hardClipping(SampleType sample);
 
  private:
-  float mix_ = 0.0f;
+  // Blend regions of mix_, each with its own kernel: dry, dry to soft, soft to hard, hard over soft, and hard
+  // alone at mix 1 where the soft clipper's weight is zero. Mix outside [0, 1] is silent.
+  enum class Region
+  {
+    Clean,
+    Soft,
+    SoftHard,
+    HardSoft,
+    Hard,
+    Off
+  };
+  static Region regionOf(float mix);
+
+  // Blend weight of sample i: mix is one value for the call, or one per sample
+  static float mixAt(const float mix, int) { return mix; }
+  static float mixAt(const float* mix, const int i) { return mix[i]; }
+
+  // Loop for one region, with only its clippers evaluated. previous is the input sample before audioIn[0], which
+  // the anti-aliased kernels start from.
+  template <Region region, bool antialiased, typename Mix>
+  static void processKernel(Mix mix, SampleType previous, const SampleType* audioIn, SampleType* audioOut,
+                            int numSamples);
+  template <typename Mix>
+  static void processRegion(Region region, bool antialiased, Mix mix, SampleType previous,
+                            const SampleType* audioIn, SampleType* audioOut, int numSamples);
+  // Both process() overloads: the current kernel at mix, crossfaded from the old one at fadeMix
+  template <typename Mix>
+  void processBlock(int channel, const SampleType* audioIn, Mix mix, Mix fadeMix, SampleType* audioOut,
+                    int numSamplesToRender);
+
+  // Inputs go through the history in chunks, so in-place calls never read a sample they have overwritten
+  static constexpr int CHUNK_SIZE = 64;
+
+  float mix_        = 0.0f;
+  Region region_    = Region::Clean;
+  bool antialiased_ = false;
+
+  // Kernel being faded out, and each channel's samples left of the fade
+  float fadeMix_        = 0.0f;
+  Region fadeRegion_    = Region::Clean;
+  bool fadeAntialiased_ = false;
+  std::vector<int> fadeRemaining_ = std::vector<int>(1);
+  std::vector<SampleType> fadeBuffer_ = std::vector<SampleType>(CROSSFADE_SAMPLES);
+
+  // Each channel's last input sample, kept up to date with the anti-aliasing off so switching it on is seamless
+  std::vector<SampleType> previous_ = std::vector<SampleType>(1);
 };
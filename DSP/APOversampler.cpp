@@ -0,0 +1,507 @@
+/*
+  ==============================================================================
+
+    APOversampler.cpp
+    Created: 17 Oct 2026 4:12:36pm
+
+  ==============================================================================
+*/
+
+#include "APOversampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace
+{
+  constexpr int NUM_STAGES = APOversampler<float>::MAX_STAGES;
+
+  // Passband edge as a fraction of the base rate, 19 kHz at 44.1 kHz. Every stage keeps its images and aliases
+  // 90 dB down outside the band from there to the mirror image of the edge, so whatever folds back lands above it.
+  constexpr double PASSBAND = 0.43;
+
+  // Linear phase: each stage is a half-band of 4m + 3 taps, Kaiser windowed. The first stage has the narrow
+  // transition, the later ones only have to clear the images of a signal already limited to the base band.
+  constexpr int FIR_HALF_LENGTHS[NUM_STAGES] { 21, 5, 3 };
+  constexpr double FIR_KAISER_BETAS[NUM_STAGES] { 9.5, 10.0, 9.5 };
+  // Minimum phase: allpass sections per stage, shared between the two polyphase paths
+  constexpr int IIR_SECTIONS[NUM_STAGES] { 7, 3, 2 };
+
+  double besselI0(const double x)
+  {
+    auto sum  = 1.0;
+    auto term = 1.0;
+    for (int k = 1; k < 50; ++k)
+    {
+      const auto factor = x / (2.0 * k);
+      term *= factor * factor;
+      sum += term;
+    }
+    return sum;
+  }
+
+  // One side of the odd taps h[c + 2j + 1], j = 0..m, of a windowed-sinc half-band centred on c = 2m + 1,
+  // normalised to unity gain at DC. The even taps are zero but the centre's 1/2, which the kernels apply as a plain
+  // delay.
+  std::vector<double> halfBandFIR(const int m, const double beta)
+  {
+    std::vector<double> taps(static_cast<size_t>(m + 1));
+    const auto halfLength = static_cast<double>(2 * m + 2);
+    auto sum              = 0.0;
+    for (int j = 0; j <= m; ++j)
+    {
+      const auto offset = static_cast<double>(2 * j + 1);
+      const auto ratio  = offset / halfLength;
+      const auto window = besselI0(beta * std::sqrt(1.0 - ratio * ratio)) / besselI0(beta);
+      taps[static_cast<size_t>(j)] = ((j & 1) != 0 ? -1.0 : 1.0) / (juce::MathConstants<double>::pi * offset) * window;
+      sum += taps[static_cast<size_t>(j)];
+    }
+    for (auto& tap : taps)
+      tap *= 0.25 / sum;  // both sides sum to 1/2, the centre is the other half
+    return taps;
+  }
+
+  // Coefficients a of the sections (a + z^-1) / (1 + a z^-1) of a polyphase allpass half-band, equiripple in both
+  // bands, following Laurent de Soras' HIIR designer. transition is the width of the transition band as a fraction
+  // of the high rate. Even indices form the first path, odd ones the second.
+  std::vector<double> halfBandIIR(const int numSections, const double transition)
+  {
+    const auto pi = juce::MathConstants<double>::pi;
+
+    auto k = std::tan((1.0 - 2.0 * transition) * pi / 4.0);
+    k *= k;
+    const auto root = std::pow(1.0 - k * k, 0.25);
+    const auto e    = 0.5 * (1.0 - root) / (1.0 + root);
+    const auto e4   = e * e * e * e;
+    const auto q    = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    const auto order = 2 * numSections + 1;
+    std::vector<double> coefficients(static_cast<size_t>(numSections));
+    for (int index = 0; index < numSections; ++index)
+    {
+      const auto c = index + 1;
+
+      // Theta function series for the section's pole, each until its terms vanish
+      auto numerator = 0.0;
+      for (int i = 0, sign = 1;; ++i, sign = -sign)
+      {
+        const auto term = std::pow(q, i * (i + 1)) * std::sin((2 * i + 1) * c * pi / order) * sign;
+        numerator += term;
+        if (std::abs(term) <= 1e-100)
+          break;
+      }
+      auto denominator = 0.5;
+      for (int i = 1, sign = -1;; ++i, sign = -sign)
+      {
+        const auto term = std::pow(q, i * i) * std::cos(2 * i * c * pi / order) * sign;
+        denominator += term;
+        if (std::abs(term) <= 1e-100)
+          break;
+      }
+
+      const auto w  = numerator * std::pow(q, 0.25) / denominator;
+      const auto w2 = w * w;
+      const auto x  = std::sqrt((1.0 - w2 * k) * (1.0 - w2 / k)) / (1.0 + w2);
+      coefficients[static_cast<size_t>(index)] = (1.0 - x) / (1.0 + x);
+    }
+    return coefficients;
+  }
+
+  template <typename SampleType>
+  struct Designs
+  {
+    std::array<std::vector<SampleType>, NUM_STAGES> fir;               // one side of the odd taps
+    std::array<std::vector<SampleType>, NUM_STAGES> iirEven, iirOdd;   // the two allpass paths
+    std::array<double, NUM_STAGES> iirDelay {};  // up and down group delay at DC, in samples of the lower rate
+
+    Designs()
+    {
+      for (int stage = 0; stage < NUM_STAGES; ++stage)
+      {
+        const auto s = static_cast<size_t>(stage);
+        for (const auto tap : halfBandFIR(FIR_HALF_LENGTHS[stage], FIR_KAISER_BETAS[stage]))
+          fir[s].push_back(static_cast<SampleType>(tap));
+
+        // The stage runs from 2^stage to 2^(stage + 1) times the base rate
+        const auto scale      = static_cast<double>(1 << (stage + 1));
+        const auto transition = (scale / 2.0 - 2.0 * PASSBAND) / scale;
+        const auto sections   = halfBandIIR(IIR_SECTIONS[stage], transition);
+        for (size_t i = 0; i < sections.size(); ++i)
+        {
+          (i % 2 == 0 ? iirEven[s] : iirOdd[s]).push_back(static_cast<SampleType>(sections[i]));
+          iirDelay[s] += (1.0 - sections[i]) / (1.0 + sections[i]);
+        }
+      }
+    }
+  };
+
+  // Built once, on the first prepare()
+  template <typename SampleType>
+  const Designs<SampleType>& designs()
+  {
+    static const Designs<SampleType> instance;
+    return instance;
+  }
+
+  // Top rate samples that pad the linear phase cascade's latency up to a whole base rate sample. Stage s delays by
+  // 2m + 1 samples of its lower rate, which is a fraction of a base rate sample from the second stage on.
+  int linearPad(const int numStages)
+  {
+    auto delay = 0;
+    for (int stage = 0; stage < numStages; ++stage)
+      delay += (2 * FIR_HALF_LENGTHS[stage] + 1) << (numStages - stage);
+    const auto factor = 1 << numStages;
+    return (factor - delay % factor) % factor;
+  }
+
+  // Moves the last history frames before x[numFrames] in front of x[0], for the next call
+  template <typename SIMD>
+  void keepHistory(SIMD* x, const int numFrames, const int history)
+  {
+    std::copy(x + numFrames - history, x + numFrames, x - history);
+  }
+
+  // Calls function with the stage as a compile-time constant, so the kernels below unroll over their taps and
+  // sections and keep them and the allpass state in registers
+  template <typename Function>
+  void withStage(const int stage, Function&& function)
+  {
+    static_assert(NUM_STAGES == 3, "one case per stage");
+    switch (stage)
+    {
+      case 0: function(std::integral_constant<int, 0> {}); break;
+      case 1: function(std::integral_constant<int, 1> {}); break;
+      default: function(std::integral_constant<int, 2> {}); break;
+    }
+  }
+
+  // 2x up: the even output is the odd taps over the input (times 2 for the zeros in between), the odd output the
+  // centre tap's delayed input. x[0] needs 2m + 1 frames of history before it.
+  template <int stage, typename SIMD, typename SampleType>
+  void firUp(const std::vector<SampleType>& design, const SIMD* x, SIMD* y, const int numFrames)
+  {
+    constexpr auto m = FIR_HALF_LENGTHS[stage];
+    std::array<SampleType, static_cast<size_t>(m) + 1> taps;
+    std::copy_n(design.begin(), m + 1, taps.begin());
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+      const auto* centre = x + i - m;
+      auto even          = (centre[0] + centre[-1]) * taps[0];
+      for (int j = 1; j <= m; ++j)
+        even += (centre[j] + centre[-1 - j]) * taps[static_cast<size_t>(j)];
+      y[2 * i]     = even + even;
+      y[2 * i + 1] = centre[0];
+    }
+  }
+
+  // 2x down, the same taps over every other input and the centre on the ones in between. x[0] needs 4m + 2 + pad
+  // frames of history before it.
+  template <int stage, typename SIMD, typename SampleType>
+  void firDown(const std::vector<SampleType>& design, const SIMD* x, SIMD* y, const int numFrames, const int pad)
+  {
+    constexpr auto m = FIR_HALF_LENGTHS[stage];
+    std::array<SampleType, static_cast<size_t>(m) + 1> taps;
+    std::copy_n(design.begin(), m + 1, taps.begin());
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+      const auto* centre = x + 2 * i - pad - 2 * m - 1;
+      auto sum           = centre[0] * SampleType(0.5);
+      for (int j = 0; j <= m; ++j)
+        sum += (centre[2 * j + 1] + centre[-2 * j - 1]) * taps[static_cast<size_t>(j)];
+      y[i] = sum;
+    }
+  }
+
+  // One path of first order allpass sections, copied in from the design and the state for a block and back out
+  // after it. Each section keeps its last input and output.
+  template <int numSections, typename SIMD, typename SampleType>
+  struct AllpassPath
+  {
+    std::array<SampleType, static_cast<size_t>(numSections)> coefficients;
+    std::array<SIMD, static_cast<size_t>(numSections)> x1, y1;
+
+    AllpassPath(const std::vector<SampleType>& design, const SIMD* state)
+    {
+      for (size_t k = 0; k < numSections; ++k)
+      {
+        coefficients[k] = design[k];
+        x1[k]           = state[2 * k];
+        y1[k]           = state[2 * k + 1];
+      }
+    }
+
+    void store(SIMD* state) const
+    {
+      for (size_t k = 0; k < numSections; ++k)
+      {
+        state[2 * k]     = x1[k];
+        state[2 * k + 1] = y1[k];
+      }
+    }
+
+    SIMD process(SIMD x)
+    {
+      for (size_t k = 0; k < numSections; ++k)
+      {
+        const auto y = (x - y1[k]) * coefficients[k] + x1[k];
+        x1[k]        = x;
+        y1[k]        = y;
+        x            = y;
+      }
+      return x;
+    }
+  };
+
+  template <int stage, typename SIMD, typename SampleType>
+  using EvenPath = AllpassPath<(IIR_SECTIONS[stage] + 1) / 2, SIMD, SampleType>;
+  template <int stage, typename SIMD, typename SampleType>
+  using OddPath = AllpassPath<IIR_SECTIONS[stage] / 2, SIMD, SampleType>;
+
+  // 2x up: each path makes one of the two outputs of every input
+  template <int stage, typename SIMD, typename SampleType>
+  void iirUp(const std::vector<SampleType>& even, const std::vector<SampleType>& odd, SIMD* state, const SIMD* x,
+             SIMD* y, const int numFrames)
+  {
+    auto* oddState = state + 2 * even.size();
+    EvenPath<stage, SIMD, SampleType> evenPath(even, state);
+    OddPath<stage, SIMD, SampleType> oddPath(odd, oddState);
+    for (int i = 0; i < numFrames; ++i)
+    {
+      y[2 * i]     = evenPath.process(x[i]);
+      y[2 * i + 1] = oddPath.process(x[i]);
+    }
+    evenPath.store(state);
+    oddPath.store(oddState);
+  }
+
+  // 2x down: the paths take the inputs in turn and their outputs average
+  template <int stage, typename SIMD, typename SampleType>
+  void iirDown(const std::vector<SampleType>& even, const std::vector<SampleType>& odd, SIMD* state, const SIMD* x,
+               SIMD* y, const int numFrames)
+  {
+    auto* oddState = state + 2 * even.size();
+    EvenPath<stage, SIMD, SampleType> evenPath(even, state);
+    OddPath<stage, SIMD, SampleType> oddPath(odd, oddState);
+    for (int i = 0; i < numFrames; ++i)
+      y[i] = (evenPath.process(x[2 * i + 1]) + oddPath.process(x[2 * i])) * SampleType(0.5);
+    evenPath.store(state);
+    oddPath.store(oddState);
+  }
+}  // namespace
+
+template <typename SampleType>
+APOversampler<SampleType>::APOversampler()
+{
+  static_assert(MAX_STAGES == NUM_STAGES, "one design per stage");
+  static_assert(4 * FIR_HALF_LENGTHS[0] + 2 <= MAX_HISTORY &&
+                    4 * FIR_HALF_LENGTHS[NUM_STAGES - 1] + 2 + MAX_FACTOR <= MAX_HISTORY,
+                "history for every stage's taps and pad");
+}
+
+template <typename SampleType>
+APOversampler<SampleType>::~APOversampler() = default;
+
+template <typename SampleType>
+void APOversampler<SampleType>::prepare(const int numChannels, const int maxSamples)
+{
+  const auto& design = designs<SampleType>();
+  maxSamples_        = juce::jmax(1, maxSamples);
+
+  groups_.resize(static_cast<size_t>((juce::jmax(1, numChannels) + LANES - 1) / LANES));
+  for (auto& group : groups_)
+  {
+    for (int stage = 0; stage < MAX_STAGES; ++stage)
+    {
+      const auto s        = static_cast<size_t>(stage);
+      const auto sections = design.iirEven[s].size() + design.iirOdd[s].size();
+      group.upInput[s].resize(static_cast<size_t>(MAX_HISTORY + (maxSamples_ << stage)));
+      group.downInput[s].resize(static_cast<size_t>(MAX_HISTORY + (maxSamples_ << (stage + 1))));
+      group.upState[s].resize(2 * sections);
+      group.downState[s].resize(2 * sections);
+    }
+    group.frames.resize(static_cast<size_t>(maxSamples_ * MAX_FACTOR));
+  }
+  oversampled_.assign(static_cast<size_t>(juce::jmax(1, numChannels) * maxSamples_ * MAX_FACTOR), SampleType(0));
+  reset();
+}
+
+template <typename SampleType>
+void APOversampler<SampleType>::setup(const int numStages, const Phase phase)
+{
+  const auto stages = juce::jlimit(0, MAX_STAGES, numStages);
+  if (stages == numStages_ && phase == phase_)
+    return;
+
+  numStages_ = stages;
+  phase_     = phase;
+  pad_       = phase == Phase::Linear ? linearPad(stages) : 0;
+  reset();
+}
+
+template <typename SampleType>
+void APOversampler<SampleType>::reset()
+{
+  for (auto& group : groups_)
+    group.clear();
+}
+
+template <typename SampleType>
+void APOversampler<SampleType>::Group::clear()
+{
+  const auto zero = SIMD::expand(SampleType(0));
+  for (auto* buffers : { &upInput, &downInput, &upState, &downState })
+    for (auto& buffer : *buffers)
+      std::fill(buffer.begin(), buffer.end(), zero);
+}
+
+template <typename SampleType>
+int APOversampler<SampleType>::getLatencySamples(const int numStages, const Phase phase)
+{
+  if (phase == Phase::Linear)
+  {
+    auto delay = linearPad(numStages);  // in top rate samples
+    for (int stage = 0; stage < numStages; ++stage)
+      delay += (2 * FIR_HALF_LENGTHS[stage] + 1) << (numStages - stage);
+    return delay >> numStages;
+  }
+
+  auto delay = 0.0;
+  for (int stage = 0; stage < numStages; ++stage)
+    delay += designs<SampleType>().iirDelay[static_cast<size_t>(stage)] / static_cast<double>(1 << stage);
+  return juce::roundToInt(delay);
+}
+
+template <typename SampleType>
+SampleType* APOversampler<SampleType>::getOversampledChannel(const int channel)
+{
+  return oversampled_.data() + static_cast<size_t>(channel * maxSamples_ * MAX_FACTOR);
+}
+
+template <typename SampleType>
+void APOversampler<SampleType>::upsample(const SampleType* const* channels, const int numChannels,
+                                         const int numSamples)
+{
+  jassert(isEnabled() && numSamples <= maxSamples_ && numChannels <= static_cast<int>(groups_.size()) * LANES);
+  const auto numOversampled = numSamples * getFactor();
+
+  for (int first = 0; first < numChannels; first += LANES)
+  {
+    auto& group      = groups_[static_cast<size_t>(first / LANES)];
+    const auto lanes = juce::jmin(LANES, numChannels - first);
+
+    auto* input = group.upInput[0].data() + MAX_HISTORY;
+    for (int lane = 0; lane < lanes; ++lane)
+    {
+      const auto* source = channels[first + lane];
+      for (int i = 0; i < numSamples; ++i)
+        input[i].set(static_cast<size_t>(lane), source[i]);
+    }
+
+    if (phase_ == Phase::Linear)
+      upsampleGroup<Phase::Linear>(group, numSamples);
+    else
+      upsampleGroup<Phase::Minimum>(group, numSamples);
+
+    for (int lane = 0; lane < lanes; ++lane)
+    {
+      auto* dest = getOversampledChannel(first + lane);
+      for (int i = 0; i < numOversampled; ++i)
+        dest[i] = group.frames[static_cast<size_t>(i)].get(static_cast<size_t>(lane));
+    }
+  }
+}
+
+template <typename SampleType>
+void APOversampler<SampleType>::downsample(SampleType* const* channels, const int numChannels, const int numSamples)
+{
+  jassert(isEnabled() && numSamples <= maxSamples_ && numChannels <= static_cast<int>(groups_.size()) * LANES);
+  const auto numOversampled = numSamples * getFactor();
+
+  for (int first = 0; first < numChannels; first += LANES)
+  {
+    auto& group      = groups_[static_cast<size_t>(first / LANES)];
+    const auto lanes = juce::jmin(LANES, numChannels - first);
+
+    auto* input = group.downInput[static_cast<size_t>(numStages_ - 1)].data() + MAX_HISTORY;
+    for (int lane = 0; lane < lanes; ++lane)
+    {
+      const auto* source = getOversampledChannel(first + lane);
+      for (int i = 0; i < numOversampled; ++i)
+        input[i].set(static_cast<size_t>(lane), source[i]);
+    }
+
+    if (phase_ == Phase::Linear)
+      downsampleGroup<Phase::Linear>(group, numSamples);
+    else
+      downsampleGroup<Phase::Minimum>(group, numSamples);
+
+    for (int lane = 0; lane < lanes; ++lane)
+    {
+      auto* dest = channels[first + lane];
+      for (int i = 0; i < numSamples; ++i)
+        dest[i] = group.frames[static_cast<size_t>(i)].get(static_cast<size_t>(lane));
+    }
+  }
+}
+
+template <typename SampleType>
+template <typename APOversampler<SampleType>::Phase phase>
+void APOversampler<SampleType>::upsampleGroup(Group& group, const int numSamples)
+{
+  const auto& design = designs<SampleType>();
+  auto numFrames     = numSamples;
+  for (int stage = 0; stage < numStages_; ++stage)
+  {
+    const auto s = static_cast<size_t>(stage);
+    auto* x      = group.upInput[s].data() + MAX_HISTORY;
+    auto* y      = stage + 1 < numStages_ ? group.upInput[s + 1].data() + MAX_HISTORY : group.frames.data();
+    withStage(stage, [&](auto constant) {
+      constexpr int index = decltype(constant)::value;
+      if constexpr (phase == Phase::Linear)
+      {
+        firUp<index>(design.fir[s], x, y, numFrames);
+        keepHistory(x, numFrames, 2 * FIR_HALF_LENGTHS[index] + 1);
+      }
+      else
+      {
+        iirUp<index>(design.iirEven[s], design.iirOdd[s], group.upState[s].data(), x, y, numFrames);
+      }
+    });
+    numFrames *= 2;
+  }
+}
+
+template <typename SampleType>
+template <typename APOversampler<SampleType>::Phase phase>
+void APOversampler<SampleType>::downsampleGroup(Group& group, const int numSamples)
+{
+  const auto& design = designs<SampleType>();
+  auto numFrames     = numSamples << (numStages_ - 1);  // outputs of the top stage
+  for (int stage = numStages_ - 1; stage >= 0; --stage)
+  {
+    const auto s = static_cast<size_t>(stage);
+    auto* x      = group.downInput[s].data() + MAX_HISTORY;
+    auto* y      = stage > 0 ? group.downInput[s - 1].data() + MAX_HISTORY : group.frames.data();
+    // The pad delays the top rate input, so it is history of the top stage
+    const auto pad = stage == numStages_ - 1 ? pad_ : 0;
+    withStage(stage, [&](auto constant) {
+      constexpr int index = decltype(constant)::value;
+      if constexpr (phase == Phase::Linear)
+      {
+        firDown<index>(design.fir[s], x, y, numFrames, pad);
+        keepHistory(x, 2 * numFrames, 4 * FIR_HALF_LENGTHS[index] + 2 + pad);
+      }
+      else
+      {
+        iirDown<index>(design.iirEven[s], design.iirOdd[s], group.downState[s].data(), x, y, numFrames);
+      }
+    });
+    numFrames /= 2;
+  }
+}
+
+template class APOversampler<float>;
+template class APOversampler<double>;
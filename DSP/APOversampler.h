@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    APOversampler.h
+    Created: 17 Oct 2026 4:12:36pm
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+
+#include <array>
+#include <vector>
+
+// Raises a block to 2, 4 or 8 times the sample rate and brings it back, so a nonlinear stage can run in between
+// with its harmonics above the base Nyquist filtered out rather than folded back. Each factor is a cascade of
+// polyphase half-band 2x stages, every one running at the lower of its two rates. The channels sit one per SIMD
+// lane, so a stereo pair costs one pass of the filters.
+template <typename SampleType>
+class APOversampler
+{
+ public:
+  static constexpr int MAX_STAGES = 3;
+  static constexpr int MAX_FACTOR = 1 << MAX_STAGES;
+
+  // Linear phase: symmetric FIR half-bands, pure delay and no phase error, at the cost of the latency.
+  // Minimum phase: allpass polyphase IIR half-bands, a few samples of latency and phase that lags towards the top
+  // of the band, with no pre-ringing.
+  enum class Phase
+  {
+    Linear,
+    Minimum
+  };
+
+  APOversampler();
+  ~APOversampler();
+
+  // Allocates the filter state and the oversampled buffers for blocks of up to maxSamples. Not real-time safe.
+  void prepare(int numChannels, int maxSamples);
+  // 0 (off) to MAX_STAGES 2x stages. A change clears the filters.
+  void setup(int numStages, Phase phase);
+  void reset();
+
+  bool isEnabled() const { return numStages_ > 0; }
+  int getFactor() const { return 1 << numStages_; }
+  // Delay of an upsample and downsample, in base rate samples. Linear phase is padded to a whole sample, minimum
+  // phase is its group delay at DC, rounded.
+  int getLatencySamples() const { return getLatencySamples(numStages_, phase_); }
+  static int getLatencySamples(int numStages, Phase phase);
+
+  // numSamples of every channel into the oversampled buffers, numSamples * getFactor() each
+  void upsample(const SampleType* const* channels, int numChannels, int numSamples);
+  SampleType* getOversampledChannel(int channel);
+  // The oversampled buffers back down into numSamples of every channel
+  void downsample(SampleType* const* channels, int numChannels, int numSamples);
+
+ private:
+  using SIMD                 = juce::dsp::SIMDRegister<SampleType>;
+  static constexpr int LANES = static_cast<int>(SIMD::SIMDNumElements);
+
+  // Frames of history in front of every stage's input: the longest FIR's, plus the pad that rounds the linear
+  // phase latency up to a whole base rate sample
+  static constexpr int MAX_HISTORY = 128;
+
+  // Up to LANES channels, each stage's input preceded by its history. upInput[s] is stage s's input at 2^s times
+  // the base rate, downInput[s] at 2^(s + 1). The IIR stages keep their allpass state instead of history.
+  struct Group
+  {
+    std::array<std::vector<SIMD>, MAX_STAGES> upInput, downInput;
+    std::array<std::vector<SIMD>, MAX_STAGES> upState, downState;
+    std::vector<SIMD> frames;  // output of the last stage either way, before it is split into channels
+    void clear();
+  };
+
+  template <Phase phase>
+  void upsampleGroup(Group& group, int numSamples);
+  template <Phase phase>
+  void downsampleGroup(Group& group, int numSamples);
+
+  int numStages_  = 0;
+  Phase phase_    = Phase::Linear;
+  int pad_        = 0;  // top rate samples of delay rounding the linear phase latency up, see getLatencySamples()
+  int maxSamples_ = 0;
+
+  std::vector<Group> groups_;
+  std::vector<SampleType> oversampled_;  // one run of maxSamples_ * MAX_FACTOR per channel
+};
@@ -10,54 +10,398 @@
 
 #include "APTubeDistortion.h"
 
+#include <algorithm>
 #include <cmath>
+#include <type_traits>
 
-APTubeDistortion::APTubeDistortion() {
-//  postHighPass_ = std::make_unique<juce::dsp::IIR::Filter<float>>();
-}
+#include "../Helpers/APMath.h"
+#include "APWaveshaperTable.h"
 
-APTubeDistortion::~APTubeDistortion() = default;
-
-void APTubeDistortion::process(const float* audioIn, const float minBufferVal, const float maxBufferVal, const float distGain, const float Q,
-                               const float distChar, float* audioOut, const int numSamplesToRender) const
+namespace
 {
+  // Parameter sources for the kernel: one value for the whole block, or a ramp buffer. Both are indexed per sample,
+  // so the constant case compiles to the original loop and the ramped one has no per-sample test for which it got.
+  struct Constant
+  {
+    float value;
+    float operator[](int) const { return value; }
+    Constant from(int) const { return *this; }
+  };
+
+  struct Ramp
+  {
+    const float* values;
+    float operator[](const int i) const { return values[i]; }
+    Ramp from(const int start) const { return { values + start }; }
+  };
+
+  // Samples per pass of the envelope and then the curve, a multiple of every SIMD width
+  constexpr int CHUNK_SIZE = 64;
+
+  // e^x - 1 to the precision of the instantiation: the fast float approximation, or the library's in double
+  template <typename SampleType>
+  SampleType sampleExpm1(const SampleType x)
+  {
+    if constexpr (std::is_same_v<SampleType, float>)
+      return APMath::fastExpm1(x);
+    else
+      return std::expm1(x);
+  }
+
+  // D(t), the integral of s / (e^s - 1) from 0 to t, with no elementary form (it is a Debye function). The
+  // antiderivative of the tube's t / (1 - e^-t) is max(t, 0)^2 / 2 + sign(t) D(|t|), so this is its bounded part.
+  // Beyond the table D is within 1e-16 of its limit, pi^2 / 6.
+  struct DebyeCurve
+  {
+    static constexpr double lower               = 0.0;
+    static constexpr double upper               = 40.0;
+    static constexpr double maxSecondDerivative = 0.5;
+    static constexpr double maxFourthDerivative = 0.05;
+    static constexpr double limit               = APMath::pi * APMath::pi / 6.0;
+
+    static constexpr double evaluate(const double t)
+    {
+      // Near 0 the integral of the series s / (e^s - 1) = sum B_n s^n / n!, which converges for |s| < 2 pi
+      if (t < 2.0)
+      {
+        constexpr double bernoulli[] { 1.0,          -1.0 / 2.0,     1.0 / 6.0,    0.0, -1.0 / 30.0,
+                                       0.0,          1.0 / 42.0,     0.0,          -1.0 / 30.0,
+                                       0.0,          5.0 / 66.0,     0.0,          -691.0 / 2730.0,
+                                       0.0,          7.0 / 6.0,      0.0,          -3617.0 / 510.0,
+                                       0.0,          43867.0 / 798.0, 0.0,         -174611.0 / 330.0 };
+        auto power     = t;    // t^(n + 1)
+        auto factorial = 1.0;  // n!
+        auto sum       = 0.0;
+        for (int n = 0; n < 21; ++n)
+        {
+          sum += bernoulli[n] * power / (static_cast<double>(n + 1) * factorial);
+          power *= t;
+          factorial *= static_cast<double>(n + 1);
+        }
+        return sum;
+      }
+
+      // Further out, pi^2 / 6 minus the tail: sum over n of e^(-nt) (t / n + 1 / n^2)
+      const auto decay = APMath::constexprExp(-t);
+      auto power       = 1.0;  // e^(-nt)
+      auto tail        = 0.0;
+      for (int n = 1; n <= 30; ++n)
+      {
+        power *= decay;
+        tail += power * (t / n + 1.0 / (static_cast<double>(n) * n));
+      }
+      return limit - tail;
+    }
+
+    template <typename T>
+    static T outside(const T)
+    {
+      return static_cast<T>(limit);
+    }
+  };
+
+  using Debye = APWaveshaper::Table<DebyeCurve>;
 
-//  auto sampleSmoothed = 0.0f;
-//  postHighPass_->snapToZero();
-  // Calculate z
-  for (auto i = 0; i < numSamplesToRender; ++i)
+  // The tube curve is z(q) = psi(k (q - Q)) / k + C, with psi(t) = t / (1 - e^-t), k = distChar and
+  // C = Q / (1 - e^kQ) (0 at Q == 0), C to the precision of the instantiation
+  template <typename SampleType>
+  struct TubeShape
   {
-    const auto& in = audioIn[i];
+    double Q, k, offset;
 
-    if (in == 0.0f || maxBufferVal == 0.0f)
+    TubeShape(const float workPoint, const float distChar)
+        : Q(static_cast<double>(workPoint)),
+          // A characteristic of 0 divides by zero in the plain curve too. This small it clamps to the range all the
+          // same.
+          k(juce::jmax(static_cast<double>(distChar), 1e-3)),
+          offset(workPoint == 0 ? 0.0
+                                : static_cast<double>(static_cast<SampleType>(workPoint) /
+                                                      -sampleExpm1(static_cast<SampleType>(distChar) *
+                                                                   static_cast<SampleType>(workPoint))))
     {
-      audioOut[i] = in;
     }
+  };
+
+  // Mean of the tube curve over [q1, q]: C plus the mean of psi over [t1, t], over k. psi's antiderivative splits
+  // into a quadratic, whose mean is taken exactly, and the tabulated D, whose mean comes from the table's divided
+  // differences for t and t1 of one sign and is a sum of positives over their distance otherwise. Nothing cancels
+  // as the samples meet.
+  template <typename Shape>
+  double tubeMean(const double q, const double q1, const Shape& shape)
+  {
+    // Zero input passes through, as in the plain curve
+    if (q == 0.0 && q1 == 0.0)
+      return 0.0;
+
+    const auto k     = shape.k;
+    const auto t     = k * (q - shape.Q);
+    const auto t1    = k * (q1 - shape.Q);
+    const auto width = t - t1;
+
+    const auto a         = juce::jmax(t, 0.0);
+    const auto b         = juce::jmax(t1, 0.0);
+    const auto quadratic = width != 0.0 ? (a - b) / width * 0.5 * (a + b) : a;
+
+    const auto u = std::abs(t);
+    const auto v = std::abs(t1);
+    double bounded;
+    if ((t >= 0.0) != (t1 >= 0.0))
+      bounded = (Debye::process(u) + Debye::process(v)) / (u + v);
+    else if (u <= DebyeCurve::upper && v <= DebyeCurve::upper)
+      bounded = Debye::slope(u, v);
     else
+      bounded = u != v ? (Debye::process(u) - Debye::process(v)) / (u - v) : 0.0;  // flat out there
+
+    return shape.offset + (quadratic + bounded) / k;
+  }
+
+  // Mean of the clamp to [low, high] over [y1, y]: the parts of the step below, inside and above the range,
+  // weighted by their lengths
+  double clampMean(const double y, const double y1, const double low, const double high)
+  {
+    const auto bottom = juce::jmin(y, y1);
+    const auto top    = juce::jmax(y, y1);
+    if (top == bottom)
+      return juce::jlimit(low, high, y);
+
+    const auto insideBottom = juce::jlimit(low, high, bottom);
+    const auto insideTop    = juce::jlimit(low, high, top);
+    const auto below        = juce::jmin(top, low) - juce::jmin(bottom, low);
+    const auto above        = juce::jmax(top, high) - juce::jmax(bottom, high);
+    return (below * low + above * high + (insideTop - insideBottom) * 0.5 * (insideBottom + insideTop)) /
+           (top - bottom);
+  }
+
+  // The positive and negative peak envelopes over one chunk: each jumps to a new extreme and falls towards 0 after
+  // it. The only recursion in the tube, a pass of its own so the curve's loop vectorises.
+  template <typename SampleType, typename State>
+  void followPeaks(const SampleType* audioIn, const SampleType release, SampleType* upper, SampleType* lower,
+                   const int numSamples, State& state)
+  {
+    auto high = state.upper;
+    auto low  = state.lower;
+    for (auto i = 0; i < numSamples; ++i)
     {
-      double z     = 0.0;
-      const auto q = in * distGain / maxBufferVal;
+      high     = juce::jmax(audioIn[i], high * release);
+      low      = juce::jmin(audioIn[i], low * release);
+      upper[i] = high;
+      lower[i] = low;
+    }
+    state.upper = high;
+    state.lower = low;
+  }
+
+  // Q, distChar, the curve's limit 1 / distChar at q == Q and its offset C, which depend on the parameters alone.
+  // Worked out once per call for constant parameters.
+  template <typename SampleType>
+  struct CurveConstants
+  {
+    SampleType Q, distChar, inverseChar, offset;
+  };
+
+  template <bool zeroQ, typename SampleType>
+  CurveConstants<SampleType> curveConstants(const float workPoint, const float characteristic)
+  {
+    const auto Q        = static_cast<SampleType>(workPoint);
+    const auto distChar = static_cast<SampleType>(characteristic);
+    const auto one      = SampleType(1);
+    if constexpr (zeroQ)
+      return { SampleType(0), distChar, one / distChar, SampleType(0) };
+
+    // The selects keep the division off Q == 0, where there is no offset, without a branch
+    const auto denominator = Q == SampleType(0) ? one : -sampleExpm1(distChar * Q);
+    return { Q, distChar, one / distChar, Q == SampleType(0) ? SampleType(0) : Q / denominator };
+  }
+
+  // The curve before the clamp. Zero input, or an envelope with no positive peak yet, passes through.
+  template <bool zeroQ, typename SampleType>
+  SampleType tubeCurve(const SampleType in, const SampleType peak, const float distGain,
+                       const CurveConstants<SampleType>& c)
+  {
+    const auto through = in == SampleType(0) || peak == SampleType(0);
+    const auto q       = in * static_cast<SampleType>(distGain) / (through ? SampleType(1) : peak);
+    const auto u       = zeroQ ? q : q - c.Q;
+
+    // 1 - exp(-x) as -expm1(-x), which stays accurate for the small x near q == Q
+    const auto oneMinusExp = -sampleExpm1(-c.distChar * u);
+    const auto denominator = u == SampleType(0) ? SampleType(1) : oneMinusExp;
+    const auto z           = (u == SampleType(0) ? c.inverseChar : u / denominator) + c.offset;
+    return through ? in : z;
+  }
+
+  // The clamp lets through whatever passes the curve untouched: with no positive peak the input is at or below 0
+  // and at or above the negative peak
+  template <bool zeroQ, typename SampleType, typename State, typename Parameter>
+  void processTube(const SampleType* audioIn, const SampleType* upper, const SampleType* lower, const float distGain,
+                   const Parameter QValues, const Parameter distCharValues, SampleType* audioOut,
+                   const int numSamplesToRender, State& state)
+  {
+    const auto constants = curveConstants<zeroQ, SampleType>(QValues[0], distCharValues[0]);
+    const auto at        = [&](const int i) {
+      return std::is_same_v<Parameter, Constant> ? constants
+                                                 : curveConstants<zeroQ, SampleType>(QValues[i], distCharValues[i]);
+    };
+
+    // The last sample's state first, as the output may overwrite the input
+    const auto last = numSamplesToRender - 1;
+    state.shaped    = tubeCurve<zeroQ>(audioIn[last], upper[last], distGain, at(last));
+    state.input     = audioIn[last];
+
+    for (auto i = 0; i < numSamplesToRender; ++i)
+      audioOut[i] = juce::jlimit(lower[i], upper[i], tubeCurve<zeroQ>(audioIn[i], upper[i], distGain, at(i)));
+  }
 
-      if (Q == 0)
+  // The curve in double: the means' divided differences are where float rounding would show
+  template <typename SampleType, typename State, typename Parameter>
+  void processTubeAntialiased(const SampleType* audioIn, const SampleType* upper, const SampleType* lower,
+                              const float distGain, const Parameter QValues, const Parameter distCharValues,
+                              SampleType* audioOut, const int numSamplesToRender, State& state)
+  {
+    using Shape = TubeShape<SampleType>;
+    const Shape constantShape(QValues[0], distCharValues[0]);
+    for (auto i = 0; i < numSamplesToRender; ++i)
+    {
+      const auto in = audioIn[i];
+      if (upper[i] == SampleType(0))
       {
-        z = q / (1.0 - exp(-distChar * q));
-        if (q == Q)
-        {
-          z = 1.0 / distChar;
-        }
+        audioOut[i]  = in;
+        state.shaped = in;
       }
       else
       {
-        z = (q - Q) / (1.0 - exp(-distChar * (q - Q))) + Q / (1.0 - exp(distChar * Q));
-//        jassert(static_cast<bool>(z));
-        if (q == Q)
+        const auto scale  = static_cast<double>(distGain) / static_cast<double>(upper[i]);
+        const auto shape  = std::is_same_v<Parameter, Constant> ? constantShape : Shape(QValues[i], distCharValues[i]);
+        const auto shaped = tubeMean(static_cast<double>(in) * scale, static_cast<double>(state.input) * scale, shape);
+        audioOut[i]       = static_cast<SampleType>(
+            clampMean(shaped, state.shaped, static_cast<double>(lower[i]), static_cast<double>(upper[i])));
+        state.shaped = static_cast<SampleType>(shaped);
+      }
+      state.input = in;
+    }
+  }
+
+  // The curve over one chunk, with the anti-aliasing on or off. A constant Q of 0 has no offset to add, and no
+  // q - Q to take.
+  template <typename SampleType, typename State, typename Parameter>
+  void shapeChunk(const bool antialiased, const bool zeroQ, const SampleType* in, const SampleType* upper,
+                  const SampleType* lower, const float distGain, const Parameter Q, const Parameter distChar,
+                  SampleType* out, const int numSamples, State& state)
+  {
+    if (antialiased)
+      processTubeAntialiased(in, upper, lower, distGain, Q, distChar, out, numSamples, state);
+    else if (zeroQ)
+      processTube<true>(in, upper, lower, distGain, Q, distChar, out, numSamples, state);
+    else
+      processTube<false>(in, upper, lower, distGain, Q, distChar, out, numSamples, state);
+  }
+
+  // Every path a chunk at a time: the envelopes for the chunk, then the curve over it, and over the head of a
+  // crossfade the old kernel's curve too
+  template <typename SampleType, typename State, typename Parameter>
+  void processChunks(const SampleType* audioIn, const float distGain, const Parameter QValues,
+                     const Parameter distCharValues, SampleType* audioOut, const int numSamplesToRender,
+                     const bool antialiased, const SampleType release, State& state)
+  {
+    constexpr auto crossfade = APTubeDistortion<SampleType>::CROSSFADE_SAMPLES;
+    const auto zeroQ         = std::is_same_v<Parameter, Constant> && QValues[0] == 0.0f;
+
+    SampleType upper[CHUNK_SIZE], lower[CHUNK_SIZE], faded[CHUNK_SIZE];
+    for (int start = 0; start < numSamplesToRender; start += CHUNK_SIZE)
+    {
+      const auto numSamples = juce::jmin(CHUNK_SIZE, numSamplesToRender - start);
+      const auto* in        = audioIn + start;
+      auto* out             = audioOut + start;
+      const auto Q          = QValues.from(start);
+      const auto distChar   = distCharValues.from(start);
+
+      followPeaks(in, release, upper, lower, numSamples, state);
+
+      // The old kernel from its own curve state, before an in-place call overwrites the input
+      const auto fade = juce::jmin(state.fadeRemaining, numSamples);
+      if (fade > 0)
+      {
+        auto old   = state;
+        old.shaped = state.fadeShaped;
+        shapeChunk(!antialiased, zeroQ, in, upper, lower, distGain, Q, distChar, faded, fade, old);
+        state.fadeShaped = old.shaped;
+      }
+
+      shapeChunk(antialiased, zeroQ, in, upper, lower, distGain, Q, distChar, out, numSamples, state);
+
+      if (fade > 0)
+      {
+        const auto done = crossfade - state.fadeRemaining;
+        for (auto i = 0; i < fade; ++i)
         {
-          z = 1 / distChar + Q / (1.0 - exp(distChar * Q));
+          const auto weight = static_cast<SampleType>(done + i + 1) / static_cast<SampleType>(crossfade);
+          out[i]            = faded[i] + weight * (out[i] - faded[i]);
         }
+        state.fadeRemaining -= fade;
       }
-
-//      sampleSmoothed = sampleSmoothed - 0.004f * (sampleSmoothed - static_cast<float>(z));
-      audioOut[i] = juce::jlimit(minBufferVal, maxBufferVal, static_cast<float>(z));
     }
   }
-}
\ No newline at end of file
+}  // namespace
+
+template <typename SampleType>
+APTubeDistortion<SampleType>::APTubeDistortion() {
+//  postHighPass_ = std::make_unique<juce::dsp::IIR::Filter<float>>();
+}
+
+template <typename SampleType>
+APTubeDistortion<SampleType>::~APTubeDistortion() = default;
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::prepare(const float sampleRate, const int numChannels)
+{
+  channels_.assign(static_cast<size_t>(juce::jmax(1, numChannels)), ChannelState {});
+  setSampleRate(sampleRate);
+}
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::setSampleRate(const float sampleRate)
+{
+  const auto releaseSamples = static_cast<double>(ENVELOPE_RELEASE) * static_cast<double>(sampleRate);
+  release_                  = static_cast<SampleType>(std::exp(-1.0 / releaseSamples));
+}
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::setAntialiasing(const bool antialiased)
+{
+  if (antialiased == antialiased_)
+    return;
+
+  // A fade already under way restarts from the kernel that was current
+  for (auto& state : channels_)
+  {
+    state.fadeShaped    = state.shaped;
+    state.fadeRemaining = CROSSFADE_SAMPLES;
+  }
+  antialiased_ = antialiased;
+}
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::reset()
+{
+  std::fill(channels_.begin(), channels_.end(), ChannelState {});
+}
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::process(const int channel, const SampleType* audioIn, const float distGain,
+                                           const float Q, const float distChar, SampleType* audioOut,
+                                           const int numSamplesToRender)
+{
+  processChunks(audioIn, distGain, Constant { Q }, Constant { distChar }, audioOut, numSamplesToRender, antialiased_,
+                release_, channels_[static_cast<size_t>(channel)]);
+}
+
+template <typename SampleType>
+void APTubeDistortion<SampleType>::process(const int channel, const SampleType* audioIn, const float distGain,
+                                           const float* Q, const float* distChar, SampleType* audioOut,
+                                           const int numSamplesToRender)
+{
+  processChunks(audioIn, distGain, Ramp { Q }, Ramp { distChar }, audioOut, numSamplesToRender, antialiased_,
+                release_, channels_[static_cast<size_t>(channel)]);
+}
+
+template class APTubeDistortion<float>;
+template class APTubeDistortion<double>;
@@ -12,18 +12,63 @@
 #include "juce_core/juce_core.h"
 #include "juce_dsp/juce_dsp.h"
 
+#include <vector>
+
+template <typename SampleType>
 class APTubeDistortion
 {
  public:
   APTubeDistortion();
   ~APTubeDistortion();
 
-  // Based off DAFX 2nd edition pg. 123
-  void process(const float* audioIn, float minBufferVal, float maxBufferVal,
-                   float distGain,  // distortion amount
-                   float Q,         // work point, more negative = more linear
-                   float distChar,  // distortion character, higher = harder, >0
-                   float* audioOut, int numSamplesToRender) const;
+  // Seconds for the peak envelope the input is normalised to to fall by 1/e once the peak has passed
+  static constexpr float ENVELOPE_RELEASE = 0.3f;
+  // Seconds of silence for the envelope to fall below -120 dB of the last peak (e^-14 < 1e-6), after which reset()
+  // changes the output by no more than the post filters' residue
+  static constexpr double ENVELOPE_SETTLE_TIME = static_cast<double>(ENVELOPE_RELEASE) * 14.0;
+  // Samples over which switching the anti-aliasing fades from the old kernel to the new one
+  static constexpr int CROSSFADE_SAMPLES = 128;
+  // Delay the anti-aliasing adds, in samples at the rate process() runs
+  static constexpr int ANTIALIASING_LATENCY = 1;
+
+  // Allocates the per-channel state. Not real-time safe.
+  void prepare(float sampleRate, int numChannels);
+  // The rate process() runs at, the oversampled one while the tube is oversampled. Sets the envelope's release.
+  void setSampleRate(float sampleRate);
+  void reset();
+
+  // Anti-aliased, the curve and then the clamp to the envelope each output their mean over the step from the
+  // previous sample (first-order antiderivative anti-aliasing), which delays the signal by ANTIALIASING_LATENCY.
+  // A switch crossfades every channel from the old kernel over CROSSFADE_SAMPLES.
+  void setAntialiasing(bool antialiased);
+
+  // Based off DAFX 2nd edition pg. 123. The input is normalised to its positive peak envelope, which jumps to every
+  // new peak and then falls by ENVELOPE_RELEASE, and the output clamped between that and its negative counterpart.
+  // Both run on from one call to the next, so the output does not depend on how the signal is split into blocks.
+  void process(int channel, const SampleType* audioIn,
+               float distGain,  // distortion amount
+               float Q,         // work point, more negative = more linear
+               float distChar,  // distortion character, higher = harder, >0
+               SampleType* audioOut, int numSamplesToRender);
+  // Same, with per-sample Q and distChar (parameter ramps)
+  void process(int channel, const SampleType* audioIn, float distGain, const float* Q, const float* distChar,
+               SampleType* audioOut, int numSamplesToRender);
 
  private:
+  // Last input, and last output of the curve before the clamp, kept up to date with the anti-aliasing off too. Then
+  // the positive and negative peak envelopes, and the kernel being faded out's own last curve output and the
+  // samples left of its fade.
+  struct ChannelState
+  {
+    SampleType input      = SampleType(0);
+    SampleType shaped     = SampleType(0);
+    SampleType upper      = SampleType(0);
+    SampleType lower      = SampleType(0);
+    SampleType fadeShaped = SampleType(0);
+    int fadeRemaining     = 0;
+  };
+
+  bool antialiased_   = false;
+  SampleType release_ = SampleType(0);  // per sample envelope decay, from setSampleRate()
+  std::vector<ChannelState> channels_ = std::vector<ChannelState>(1);
 };
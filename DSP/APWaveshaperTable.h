@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    APWaveshaperTable.h
+    Created: 17 Oct 2026 4:20:13pm
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include "../Helpers/APMath.h"
+
+// Interpolated lookup of a static waveshaping curve. The table is generated at compile time from the curve's
+// constexpr definition, sized so the interpolation error stays below 10^-Digits, and lives in read-only data shared
+// by every instance in the process. Inputs outside the table's domain take the curve's analytic form.
+//
+// A Curve provides:
+//   static constexpr double lower, upper;                 domain covered by the table
+//   static constexpr double evaluate(double x);           the curve, evaluated at compile time to fill the table
+//   template <typename T> static T outside(T x);          the curve outside [lower, upper], evaluated at run time
+//   static constexpr double maxSecondDerivative;          bound on |f''| over the domain, sizes linear tables
+//   static constexpr double maxFourthDerivative;          bound on |f''''| over the domain, sizes cubic tables
+namespace APWaveshaper
+{
+  enum class Interpolation
+  {
+    Linear,  // error h^2 |f''| / 8
+    Cubic,   // 4-point Lagrange, error 3 h^4 |f''''| / 128
+  };
+
+  template <typename Curve, Interpolation Mode = Interpolation::Cubic, int Digits = 6>
+  class Table
+  {
+   public:
+    // Beyond 6 digits the float table's own rounding dominates
+    static_assert(Digits > 0 && Digits <= 6, "the table holds floats");
+    static_assert(Curve::upper > Curve::lower, "empty domain");
+
+    static constexpr double tolerance = []() {
+      auto value = 1.0;
+      for (int digit = 0; digit < Digits; ++digit)
+        value /= 10.0;
+      return value;
+    }();
+
+    // Largest step meeting the tolerance, then the number of points it takes to cover the domain. The interpolation
+    // gets 90% of the tolerance, the rest is left for the rounding of the float table.
+    static constexpr double maxStep = Mode == Interpolation::Linear
+                                          ? APMath::constexprSqrt(0.9 * 8.0 * tolerance / Curve::maxSecondDerivative)
+                                          : APMath::constexprSqrt(APMath::constexprSqrt(
+                                                0.9 * 128.0 * tolerance / (3.0 * Curve::maxFourthDerivative)));
+    static constexpr int SIZE = static_cast<int>((Curve::upper - Curve::lower) / maxStep) + 2;
+
+    template <typename SampleType>
+    static SampleType process(const SampleType x)
+    {
+      if (!(x >= SampleType(Curve::lower) && x <= SampleType(Curve::upper)))
+        return Curve::outside(x);
+
+      // x sits between points i and i + 1, t of the way along. The top of the domain falls in the last interval.
+      const auto position = (x - SampleType(Curve::lower)) * SampleType(INVERSE_STEP);
+      const auto i        = juce::jmin(static_cast<int>(position), SIZE - 2);
+      const auto t        = position - static_cast<SampleType>(i);
+      const auto* p       = TABLE.data() + i;  // p[1] is point i, after the guard point at the front
+
+      if constexpr (Mode == Interpolation::Linear)
+      {
+        return SampleType(p[1]) + t * (SampleType(p[2]) - SampleType(p[1]));
+      }
+      else
+      {
+        // The Lagrange cubic through the four points, in powers of t
+        const auto p0    = SampleType(p[0]);
+        const auto p1    = SampleType(p[1]);
+        const auto p2    = SampleType(p[2]);
+        const auto p3    = SampleType(p[3]);
+        const auto sixth = SampleType(1) / 6;
+        const auto c1    = p2 - SampleType(0.5) * p1 - sixth * (2 * p0 + p3);
+        const auto c2    = SampleType(0.5) * (p0 + p2) - p1;
+        const auto c3    = SampleType(0.5) * (p1 - p2) + sixth * (p3 - p0);
+        return ((c3 * t + c2) * t + c1) * t + p1;
+      }
+    }
+
+    template <typename SampleType>
+    static void process(const SampleType* audioIn, SampleType* audioOut, const int numSamples)
+    {
+      for (auto i = 0; i < numSamples; ++i)
+        audioOut[i] = process(audioIn[i]);
+    }
+
+    // Mean slope of the interpolated curve between x1 and x, (f(x) - f(x1)) / (x - x1), and its slope where the two
+    // meet: what antiderivative anti-aliasing needs from a tabulated antiderivative. Points in one interval, or in
+    // the two either side of a point, use the divided differences of the interpolating polynomials, which do not
+    // cancel as x1 approaches x. Both points must lie in [lower, upper].
+    template <typename SampleType>
+    static SampleType slope(const SampleType x, const SampleType x1)
+    {
+      const auto position  = (x - SampleType(Curve::lower)) * SampleType(INVERSE_STEP);
+      const auto position1 = (x1 - SampleType(Curve::lower)) * SampleType(INVERSE_STEP);
+      const auto i         = juce::jmin(static_cast<int>(position), SIZE - 2);
+      const auto i1        = juce::jmin(static_cast<int>(position1), SIZE - 2);
+      const auto t         = position - static_cast<SampleType>(i);
+      const auto t1        = position1 - static_cast<SampleType>(i1);
+
+      if (i == i1)
+        return intervalSlope(i, t, t1) * SampleType(INVERSE_STEP);
+
+      if (std::abs(i - i1) == 1)
+      {
+        // Split at the point between the two intervals, weighting each side by its length in steps
+        const auto lowerFirst = i < i1;
+        const auto low        = lowerFirst ? i : i1;
+        const auto tLow       = lowerFirst ? t : t1;
+        const auto tHigh      = lowerFirst ? t1 : t;
+        const auto lowLength  = SampleType(1) - tLow;
+        const auto below      = intervalSlope(low, SampleType(1), tLow);
+        const auto above      = intervalSlope(low + 1, tHigh, SampleType(0));
+        return (lowLength * below + tHigh * above) / (lowLength + tHigh) * SampleType(INVERSE_STEP);
+      }
+
+      return (process(x) - process(x1)) / (x - x1);
+    }
+
+   private:
+    // Divided difference of the interpolant over interval i, between t1 and t along it, per step
+    template <typename SampleType>
+    static SampleType intervalSlope(const int i, const SampleType t, const SampleType t1)
+    {
+      const auto* p = TABLE.data() + i;
+      const auto p0 = SampleType(p[0]);
+      const auto p1 = SampleType(p[1]);
+      const auto p2 = SampleType(p[2]);
+      const auto p3 = SampleType(p[3]);
+
+      if constexpr (Mode == Interpolation::Linear)
+      {
+        juce::ignoreUnused(p0, p3, t, t1);
+        return p2 - p1;
+      }
+      else
+      {
+        // (c(t) - c(t1)) / (t - t1) for the cubic c1 t + c2 t^2 + c3 t^3 of process()
+        const auto sixth = SampleType(1) / 6;
+        const auto c1    = p2 - SampleType(0.5) * p1 - sixth * (2 * p0 + p3);
+        const auto c2    = SampleType(0.5) * (p0 + p2) - p1;
+        const auto c3    = SampleType(0.5) * (p1 - p2) + sixth * (p3 - p0);
+        return c1 + c2 * (t + t1) + c3 * (t * t + t * t1 + t1 * t1);
+      }
+    }
+
+    static constexpr double STEP         = (Curve::upper - Curve::lower) / (SIZE - 1);
+    static constexpr double INVERSE_STEP = 1.0 / STEP;
+
+    // SIZE points over the domain, with a guard point either side for the cubic's outer taps
+    static constexpr std::array<float, static_cast<size_t>(SIZE) + 2> TABLE = []() {
+      std::array<float, static_cast<size_t>(SIZE) + 2> table {};
+      for (int i = 0; i < SIZE + 2; ++i)
+        table[static_cast<size_t>(i)] = static_cast<float>(Curve::evaluate(Curve::lower + (i - 1) * STEP));
+      return table;
+    }();
+  };
+}  // namespace APWaveshaper
@@ -13,6 +13,8 @@
 #include <juce_core/juce_core.h>
 #include <juce_graphics/juce_graphics.h>
 
+#include <array>
+
 #include "BinaryData.h"
 
 namespace APConstants
@@ -49,57 +51,185 @@ namespace APConstants
   namespace Math
   {
     inline constexpr float MINUS_INF_DB = -96.0f;
+    inline constexpr double PARAMETER_RAMP_TIME = 0.05;  // seconds for a parameter change to reach its target
+    // Silence handling. Samples for the post filters' impulse response to fall below -120 dB, seconds for the
+    // lowest crossover's, and release times for a detector to settle within 1e-5 of its target.
+    inline constexpr int POST_FILTER_TAIL_SAMPLES = 1024;
+    inline constexpr double CROSSOVER_TAIL        = 0.1;
+    inline constexpr double RELEASE_SETTLE_TIMES  = 5.0;
   }
 }  // namespace APConstants
 
 namespace APParameters
 {
-  inline constexpr auto THRESHOLD_ID       = "THR";
-  inline constexpr auto THRESHOLD_NAME     = "Threshold";
-  inline constexpr auto THRESHOLD_SUFFIX   = "dBFS";
-  inline constexpr auto THRESHOLD_START    = -96.0f;
-  inline constexpr auto THRESHOLD_END      = 0.0f;
-  inline constexpr auto THRESHOLD_INTERVAL = 0.1f;
-  inline constexpr auto THRESHOLD_DEFAULT  = 0.0f;
-
-  inline constexpr auto RATIO_ID       = "RAT";
-  inline constexpr auto RATIO_NAME     = "Ratio";
-  inline constexpr auto RATIO_SUFFIX   = ": 1";
-  inline constexpr auto RATIO_START    = 1.0f;
-  inline constexpr auto RATIO_END      = 100.0f;
-  inline constexpr auto RATIO_INTERVAL = 0.1f;
-  inline constexpr auto RATIO_SKEW     = 0.3f;
-  inline constexpr auto RATIO_DEFAULT  = 1.0f;
-
-  inline constexpr auto MIX_ID       = "MIX";
-  inline constexpr auto MIX_NAME     = "Global Mix";
-  inline constexpr auto MIX_SUFFIX   = "";
-  inline constexpr auto MIX_START    = 0.0f;
-  inline constexpr auto MIX_END      = 1.0f;
-  inline constexpr auto MIX_INTERVAL = 0.01f;
-  inline constexpr auto MIX_DEFAULT  = 0.0f;
-
-  inline constexpr auto DISTQ_ID       = "DSQ";
-  inline constexpr auto DISTQ_NAME     = "Distortion Q";
-  inline constexpr auto DISTQ_SUFFIX   = "";
-  inline constexpr auto DISTQ_START    = -1.0f;
-  inline constexpr auto DISTQ_END      = 1.0f;
-  inline constexpr auto DISTQ_INTERVAL = 0.1f;
-  inline constexpr auto DISTQ_DEFAULT  = 0.0f;
-
-  inline constexpr auto DIST_CHAR_ID       = "DSC";
-  inline constexpr auto DIST_CHAR_NAME     = "Distortion Characteristic";
-  inline constexpr auto DIST_CHAR_SUFFIX   = "";
-  inline constexpr auto DIST_CHAR_START    = 0.0f;
-  inline constexpr auto DIST_CHAR_END      = 10.0f;
-  inline constexpr auto DIST_CHAR_INTERVAL = 0.1f;
-  inline constexpr auto DIST_CHAR_DEFAULT  = 2.0f;
-
-  inline constexpr auto MAKEUP_ID       = "MUP";
-  inline constexpr auto MAKEUP_NAME     = "Makeup";
-  inline constexpr auto MAKEUP_SUFFIX   = "dB";
-  inline constexpr auto MAKEUP_START    = -30.0f;
-  inline constexpr auto MAKEUP_END      = 30.0f;
-  inline constexpr auto MAKEUP_INTERVAL = 0.1f;
-  inline constexpr auto MAKEUP_DEFAULT  = 0.0f;
+  // Compile-time index of every parameter, the order of REGISTRY and of the host's parameter list. Append new
+  // parameters at the end: hosts address automation by position as well as by ID.
+  enum Index : int
+  {
+    Threshold,
+    Ratio,
+    Mix,
+    DistQ,
+    DistChar,
+    Makeup,
+    Attack,
+    Release,
+    Knee,
+    Lookahead,
+    Detector,
+    Topology,
+    Character,
+    ControlRate,
+    LinkGroups,
+    StereoMode,
+    StereoLink,
+    RMSWindow,
+    KeyFilter,
+    KeyFilterFreq,
+    CurveTable,
+    Bands,
+    XoverLow,
+    XoverMid,
+    XoverHigh,
+    StageOrder,
+    BypassCompressor,
+    BypassOverdrive,
+    BypassTube,
+    BypassFilters,
+    Antialiasing,
+    Oversampling,
+    OversamplingPhase,
+    NumParameters
+  };
+
+  enum class Type
+  {
+    Float,
+    Choice,
+    Bool,
+  };
+
+  struct Descriptor
+  {
+    Index index;
+    const char* id;
+    const char* name;
+    Type type;
+    float start        = 0.0f;
+    float end          = 1.0f;
+    float interval     = 0.0f;
+    float skew         = 1.0f;
+    float defaultValue = 0.0f;  // value, choice index, or 0/1
+    const char* suffix = "";
+    const char* const* choices = nullptr;
+    int numChoices             = 0;
+  };
+
+  constexpr Descriptor floatParameter(const Index index, const char* id, const char* name, const char* suffix,
+                                      const float start, const float end, const float interval, const float skew,
+                                      const float defaultValue)
+  {
+    return { index, id, name, Type::Float, start, end, interval, skew, defaultValue, suffix };
+  }
+
+  template <size_t N>
+  constexpr Descriptor choiceParameter(const Index index, const char* id, const char* name,
+                                       const char* const (&choices)[N], const int defaultChoice)
+  {
+    return { index, id, name, Type::Choice, 0.0f, static_cast<float>(N - 1), 1.0f, 1.0f,
+             static_cast<float>(defaultChoice), "", choices, static_cast<int>(N) };
+  }
+
+  constexpr Descriptor boolParameter(const Index index, const char* id, const char* name, const bool defaultValue)
+  {
+    return { index, id, name, Type::Bool, 0.0f, 1.0f, 1.0f, 1.0f, defaultValue ? 1.0f : 0.0f };
+  }
+
+  inline constexpr const char* DETECTOR_CHOICES[] { "Peak", "RMS (approx.)", "RMS (windowed)", "Peak (log)" };
+  inline constexpr const char* TOPOLOGY_CHOICES[] { "Feed-forward", "Feedback" };
+  inline constexpr const char* CHARACTER_CHOICES[] { "VCA", "Opto" };
+  inline constexpr const char* CONTROL_RATE_CHOICES[] { "Every Sample", "8 Samples", "16 Samples", "32 Samples" };
+  inline constexpr std::array<int, 4> CONTROL_RATE_INTERVALS { 1, 8, 16, 32 };  // samples, per choice
+  // Which channels of a surround bus share a linked detector. Each choice names its groups, LFE is its own group
+  // in all but the first.
+  inline constexpr const char* LINK_GROUPS_CHOICES[] { "All Channels", "All but LFE", "Beds / Heights / LFE",
+                                                       "Fronts / Surrounds / Heights / LFE" };
+  inline constexpr const char* STEREO_MODE_CHOICES[] { "L/R", "M/S" };
+  inline constexpr const char* STEREO_LINK_CHOICES[] { "Off", "Max", "Mean", "RMS Sum" };
+  inline constexpr const char* BANDS_CHOICES[] { "Off", "3 Bands", "4 Bands" };
+  // Order of the compressor and the two saturators. The post filters always close the chain.
+  inline constexpr const char* STAGE_ORDER_CHOICES[] { "Comp > Drive > Tube", "Comp > Tube > Drive",
+                                                       "Drive > Comp > Tube", "Tube > Comp > Drive" };
+
+  // Rate the overdrive and tube run at, and the filters that get them there and back. The index is the number of 2x
+  // stages, see APOversampler.
+  inline constexpr const char* OVERSAMPLING_CHOICES[] { "Off", "2x", "4x", "8x" };
+  inline constexpr const char* OVERSAMPLING_PHASE_CHOICES[] { "Linear Phase", "Minimum Phase" };
+
+  // clang-format off
+  inline constexpr std::array<Descriptor, NumParameters> REGISTRY { {
+    //             index          id     name                           suffix  start     end       step  skew  default
+    floatParameter(Threshold,     "THR", "Threshold",                   "dBFS", -96.0f,   0.0f,     0.1f, 1.0f, 0.0f),
+    floatParameter(Ratio,         "RAT", "Ratio",                       ": 1",  1.0f,     100.0f,   0.1f, 0.3f, 1.0f),
+    floatParameter(Mix,           "MIX", "Global Mix",                  "",     0.0f,     1.0f,     0.01f, 1.0f, 0.0f),
+    floatParameter(DistQ,         "DSQ", "Distortion Q",                "",     -1.0f,    1.0f,     0.1f, 1.0f, 0.0f),
+    floatParameter(DistChar,      "DSC", "Distortion Characteristic",   "",     0.0f,     10.0f,    0.1f, 1.0f, 2.0f),
+    floatParameter(Makeup,        "MUP", "Makeup",                      "dB",   -30.0f,   30.0f,    0.1f, 1.0f, 0.0f),
+    floatParameter(Attack,        "ATK", "Attack",                      "ms",   0.1f,     200.0f,   0.1f, 0.4f, 20.0f),
+    floatParameter(Release,       "REL", "Release",                     "ms",   5.0f,     2000.0f,  1.0f, 0.4f, 80.0f),
+    floatParameter(Knee,          "KNE", "Knee Width",                  "dB",   0.0f,     24.0f,    0.1f, 1.0f, 6.0f),
+    floatParameter(Lookahead,     "LKA", "Lookahead",                   "ms",   0.0f,     10.0f,    0.1f, 1.0f, 0.0f),
+    choiceParameter(Detector,     "DET", "Detector",                    DETECTOR_CHOICES, 1),
+    choiceParameter(Topology,     "TOP", "Topology",                    TOPOLOGY_CHOICES, 0),
+    choiceParameter(Character,    "CHR", "Character",                   CHARACTER_CHOICES, 0),
+    choiceParameter(ControlRate,  "CTL", "Gain Update",                 CONTROL_RATE_CHOICES, 0),
+    choiceParameter(LinkGroups,   "LGR", "Link Groups",                 LINK_GROUPS_CHOICES, 1),
+    choiceParameter(StereoMode,   "STM", "Stereo Mode",                 STEREO_MODE_CHOICES, 0),
+    choiceParameter(StereoLink,   "LNK", "Channel Link",                STEREO_LINK_CHOICES, 0),
+    floatParameter(RMSWindow,     "RMW", "RMS Window",                  "ms",   1.0f,     100.0f,   0.1f, 1.0f, 10.0f),
+    boolParameter(KeyFilter,      "KFE", "Sidechain Filter",            false),
+    floatParameter(KeyFilterFreq, "KFF", "Sidechain Filter Freq",       "Hz",   20.0f,    500.0f,   1.0f, 0.5f, 100.0f),
+    boolParameter(CurveTable,     "CTB", "Gain Curve Table",            false),
+    choiceParameter(Bands,        "BND", "Multiband",                   BANDS_CHOICES, 0),
+    floatParameter(XoverLow,      "XLO", "Low Crossover",               "Hz",   40.0f,    500.0f,   1.0f, 0.5f, 120.0f),
+    floatParameter(XoverMid,      "XMD", "Mid Crossover",               "Hz",   300.0f,   4000.0f,  1.0f, 0.5f, 1000.0f),
+    floatParameter(XoverHigh,     "XHI", "High Crossover",              "Hz",   2000.0f,  16000.0f, 1.0f, 0.5f, 6000.0f),
+    choiceParameter(StageOrder,   "ORD", "Stage Order",                 STAGE_ORDER_CHOICES, 0),
+    boolParameter(BypassCompressor, "BYC", "Bypass Compressor",         false),
+    boolParameter(BypassOverdrive, "BYD", "Bypass Overdrive",           true),
+    boolParameter(BypassTube,     "BYT", "Bypass Tube",                 false),
+    boolParameter(BypassFilters,  "BYF", "Bypass Post Filters",         false),
+    boolParameter(Antialiasing,   "AAL", "Saturation Anti-aliasing",    false),
+    choiceParameter(Oversampling, "OVS", "Saturation Oversampling",     OVERSAMPLING_CHOICES, 0),
+    choiceParameter(OversamplingPhase, "OVP", "Oversampling Filter",    OVERSAMPLING_PHASE_CHOICES, 0),
+  } };
+  // clang-format on
+
+  constexpr const char* id(const Index index) { return REGISTRY[static_cast<size_t>(index)].id; }
+
+  namespace Detail
+  {
+    constexpr bool sameId(const char* a, const char* b)
+    {
+      while (*a != '\0' && *a == *b)
+        ++a, ++b;
+      return *a == *b;
+    }
+
+    // Every entry at its own index, every ID unique, every default inside its range
+    constexpr bool isValidRegistry()
+    {
+      for (size_t i = 0; i < REGISTRY.size(); ++i)
+      {
+        const auto& entry = REGISTRY[i];
+        if (static_cast<size_t>(entry.index) != i || entry.defaultValue < entry.start || entry.defaultValue > entry.end)
+          return false;
+        for (size_t j = 0; j < i; ++j)
+          if (sameId(REGISTRY[j].id, entry.id))
+            return false;
+      }
+      return true;
+    }
+  }  // namespace Detail
+  static_assert(Detail::isValidRegistry(), "APParameters::REGISTRY out of Index order, duplicated or out of range");
 }  // namespace APParameters
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    APMath.h
+    Created: 17 Oct 2026 10:12:41am
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace APMath
+{
+  inline const float log2ToDecibels = static_cast<float>(20.0 * std::log10(2.0));  // 20 * log10(x) == log2(x) * log2ToDecibels
+  inline const float decibelsToLog2 = static_cast<float>(std::log2(10.0) / 20.0);  // 10^(x / 20) == 2^(x * decibelsToLog2)
+
+  // Polynomial log2/exp2 on the float bit pattern. No calls or branches, so the loops using them vectorise.
+  // fastLog2 max abs error 1.5e-5 (about 1e-4 dB) for normal positive inputs, fastExp2 max rel error 8e-8 in [-126, 126].
+  inline float fastLog2(const float x)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const auto exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+    bits                = (bits & 0x007FFFFFu) | 0x3F800000u;
+    float mantissa;
+    std::memcpy(&mantissa, &bits, sizeof(mantissa));
+    const auto t = mantissa - 1.0f;  // [0, 1)
+    return exponent +
+           t * (1.441965442f + t * (-0.7096610798f + t * (0.4175903408f + t * (-0.1962629278f + t * 0.04638251137f))));
+  }
+
+  inline float fastExp2(float x)
+  {
+    x          = juce::jlimit(-126.0f, 126.0f, x);
+    auto whole = static_cast<int32_t>(x);
+    whole -= static_cast<int32_t>(x < static_cast<float>(whole));  // floor
+    const auto t      = x - static_cast<float>(whole);              // [0, 1)
+    const auto result = 0.9999999251f + t * (0.6931530721f + t * (0.2401536229f + t * (0.05582630674f +
+                                             t * (0.008989348762f + t * 0.001877574644f))));
+    const auto bits   = static_cast<uint32_t>(whole + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return result * scale;
+  }
+
+  // Approximations built on the two above, in the same style: branch-free, call-free, so the loops using them
+  // vectorise. Maximum errors, measured by the sweeps in Tests/tester.cpp against libm in double:
+  //   gainToDecibels  abs 1e-4 dB, for normal positive gains
+  //   decibelsToGain  rel 2e-7 + 1.5e-8 |dB|, in [-120, 120] dB
+  //   fastExp         rel 2e-7 + 1e-7 |x|, in [-87, 87]
+  //   fastExpm1       rel 3e-7 + 1.5e-7 |x|, in [-87, 87]. The series near 0 keeps the error relative where
+  //                   exp(x) - 1 would cancel.
+  //   fastAtan        abs 2e-7, for any x
+  //   fastSin         abs 2e-7 for |x| <= 1e4, worsening slowly beyond as k pi loses bits
+  //   fastCos         the same
+  //   fastLog         abs 1.5e-7 + rel 1.2e-7 for normal positive x, and rel 2.5e-7 in [0.5, 2]
+  // The error that grows with |x| comes from rounding x before the exponential, which no polynomial can undo.
+  inline float gainToDecibels(const float gain) { return fastLog2(gain) * log2ToDecibels; }
+  inline float decibelsToGain(const float decibels) { return fastExp2(decibels * decibelsToLog2); }
+
+  inline float fastExp(const float x) { return fastExp2(x * 1.442695041f); }
+
+  inline float fastExpm1(const float x)
+  {
+    const auto series =
+        x * (1.0f + x * (1.0f / 2.0f + x * (1.0f / 6.0f + x * (1.0f / 24.0f + x * (1.0f / 120.0f +
+             x * (1.0f / 720.0f + x * (1.0f / 5040.0f + x * (1.0f / 40320.0f))))))));
+    return std::abs(x) < 0.5f ? series : fastExp(x) - 1.0f;
+  }
+
+  inline float fastAtan(const float x)
+  {
+    // atan(a) = pi/2 - atan(1/a) above 1, so the polynomial (Abramowitz & Stegun 4.4.49) only sees [0, 1]
+    const auto a  = std::abs(x);
+    const auto z  = juce::jmin(a, 1.0f) / juce::jmax(a, 1.0f);
+    const auto z2 = z * z;
+    const auto p  = z * (0.9999993329f + z2 * (-0.3332985605f + z2 * (0.1994653599f + z2 * (-0.1390853351f +
+                    z2 * (0.0964200441f + z2 * (-0.0559098861f + z2 * (0.0218612288f + z2 * -0.0040540580f)))))));
+    return std::copysign(a > 1.0f ? 1.570796327f - p : p, x);
+  }
+
+  namespace Detail
+  {
+    // sin(r) for |r| <= pi/2
+    inline float reducedSin(const float r)
+    {
+      const auto r2 = r * r;
+      return r + r * r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f + r2 * (-1.0f / 5040.0f +
+                 r2 * (1.0f / 362880.0f + r2 * (-1.0f / 39916800.0f)))));
+    }
+  }  // namespace Detail
+
+  inline float fastSin(const float x)
+  {
+    // x = k pi + r with |r| <= pi/2 and sin(x) = (-1)^k sin(r). Pi is split so k * 3.140625 is exact.
+    const auto y  = juce::jlimit(-4194304.0f, 4194304.0f, x * 0.3183098862f);
+    const auto k  = static_cast<int32_t>(y + std::copysign(0.5f, y));
+    const auto kf = static_cast<float>(k);
+    const auto s  = Detail::reducedSin((x - kf * 3.140625f) - kf * 9.676535897e-4f);
+    return (k & 1) != 0 ? -s : s;
+  }
+
+  inline float fastCos(const float x)
+  {
+    // x = (k + 1/2) pi + r with |r| <= pi/2 and cos(x) = (-1)^(k + 1) sin(r)
+    const auto y  = juce::jlimit(-4194304.0f, 4194304.0f, x * 0.3183098862f - 0.5f);
+    const auto k  = static_cast<int32_t>(y + std::copysign(0.5f, y));
+    const auto kf = static_cast<float>(k) + 0.5f;
+    const auto s  = Detail::reducedSin((x - kf * 3.140625f) - kf * 9.676535897e-4f);
+    return (k & 1) != 0 ? s : -s;
+  }
+
+  inline float fastLog(const float x)
+  {
+    // x = 2^e m with m in [sqrt(1/2), sqrt(2)), found by offsetting the bits by those of sqrt(1/2). Then
+    // ln(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.172, which keeps the error relative near x = 1.
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const auto offset   = bits - 0x3F3504F3u;
+    const auto exponent = static_cast<float>(static_cast<int32_t>(offset) >> 23);
+    bits                = (offset & 0x007FFFFFu) + 0x3F3504F3u;
+    float mantissa;
+    std::memcpy(&mantissa, &bits, sizeof(mantissa));
+    const auto s  = (mantissa - 1.0f) / (mantissa + 1.0f);
+    const auto s2 = s * s;
+    return exponent * 0.6931471806f +
+           2.0f * s * (1.0f + s2 * (1.0f / 3.0f + s2 * (1.0f / 5.0f + s2 * (1.0f / 7.0f + s2 * (1.0f / 9.0f)))));
+  }
+
+  // Block versions. Each runs its scalar function per element in a loop the compiler vectorises, so every SIMD lane
+  // performs the scalar sequence of operations and the results are bit-identical to calling the scalar one.
+  template <float (*Function)(float)>
+  inline void forEach(const float* source, float* dest, const int numSamples)
+  {
+    for (int i = 0; i < numSamples; ++i)
+      dest[i] = Function(source[i]);
+  }
+
+  inline void gainToDecibels(const float* gain, float* decibels, const int numSamples)
+  {
+    forEach<gainToDecibels>(gain, decibels, numSamples);
+  }
+  inline void decibelsToGain(const float* decibels, float* gain, const int numSamples)
+  {
+    forEach<decibelsToGain>(decibels, gain, numSamples);
+  }
+  inline void fastExp(const float* source, float* dest, const int numSamples)
+  {
+    forEach<fastExp>(source, dest, numSamples);
+  }
+  inline void fastAtan(const float* source, float* dest, const int numSamples)
+  {
+    forEach<fastAtan>(source, dest, numSamples);
+  }
+  inline void fastSin(const float* source, float* dest, const int numSamples)
+  {
+    forEach<fastSin>(source, dest, numSamples);
+  }
+  inline void fastCos(const float* source, float* dest, const int numSamples)
+  {
+    forEach<fastCos>(source, dest, numSamples);
+  }
+  inline void fastLog(const float* source, float* dest, const int numSamples)
+  {
+    forEach<fastLog>(source, dest, numSamples);
+  }
+
+  // Compile-time versions for generating tables, within a few ulps of the libm results in double. Far too slow for
+  // the audio thread.
+  inline constexpr double pi = 3.141592653589793238463;
+
+  constexpr double constexprSqrt(const double x)
+  {
+    if (x <= 0.0)
+      return 0.0;
+    // Newton from above falls monotonically until it stops improving
+    auto root = x > 1.0 ? x : 1.0;
+    while (true)
+    {
+      const auto next = 0.5 * (root + x / root);
+      if (next >= root)
+        return root;
+      root = next;
+    }
+  }
+
+  constexpr double constexprExp(const double x)
+  {
+    // e^x = 2^n e^r with |r| <= ln(2) / 2, where the series converges in 20 terms
+    constexpr double ln2 = 0.6931471805599453094;
+    const auto n         = static_cast<long long>(x / ln2 + (x >= 0.0 ? 0.5 : -0.5));
+    const auto r         = x - static_cast<double>(n) * ln2;
+    auto term            = 1.0;
+    auto sum             = 1.0;
+    for (int k = 1; k < 20; ++k)
+    {
+      term *= r / static_cast<double>(k);
+      sum += term;
+    }
+    for (auto i = n; i > 0; --i)
+      sum *= 2.0;
+    for (auto i = n; i < 0; ++i)
+      sum *= 0.5;
+    return sum;
+  }
+
+  constexpr double constexprSin(double x)
+  {
+    // To [-pi, pi], then to [-pi/2, pi/2] where the series converges in a dozen terms
+    const auto turns = static_cast<long long>(x / (2.0 * pi) + (x >= 0.0 ? 0.5 : -0.5));
+    x -= static_cast<double>(turns) * 2.0 * pi;
+    if (x > pi / 2.0)
+      x = pi - x;
+    else if (x < -pi / 2.0)
+      x = -pi - x;
+
+    const auto x2 = x * x;
+    auto term     = x;
+    auto sum      = x;
+    for (int n = 1; n < 13; ++n)
+    {
+      term *= -x2 / static_cast<double>((2 * n) * (2 * n + 1));
+      sum += term;
+    }
+    return sum;
+  }
+
+  constexpr double constexprAtan(const double x)
+  {
+    if (x < 0.0)
+      return -constexprAtan(-x);
+    if (x > 1.0)
+      return pi / 2.0 - constexprAtan(1.0 / x);
+
+    // atan(x) = 2 atan(x / (1 + sqrt(1 + x^2))) brings x below tan(pi/8)
+    const auto y  = x / (1.0 + constexprSqrt(1.0 + x * x));
+    const auto y2 = y * y;
+    auto power    = y;
+    auto sum      = y;
+    for (int n = 1; n < 26; ++n)
+    {
+      power *= -y2;
+      sum += power / static_cast<double>(2 * n + 1);
+    }
+    return 2.0 * sum;
+  }
+}  // namespace APMath
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    APParameterRamp.h
+    Created: 17 Oct 2026 1:54:20pm
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+
+// Linear ramp towards a target over a fixed time. Kernels ask for a block of values at once: while the ramp is
+// settled they read getCurrentValue() and take their constant path, while it moves fill() writes every sample's value
+// to a buffer the kernel reads without branching. Each value is computed from the start of the ramp, so a ramp filled
+// in pieces matches one filled whole bit for bit.
+class APParameterRamp
+{
+ public:
+  void reset(const double sampleRate, const double rampTime)
+  {
+    length_ = juce::jmax(1, juce::roundToInt(sampleRate * rampTime));
+    setCurrentAndTargetValue(target_);
+  }
+
+  void setCurrentAndTargetValue(const float value)
+  {
+    current_ = target_ = origin_ = value;
+    step_                        = 0.0f;
+    remaining_                   = 0;
+    elapsed_                     = 0;
+  }
+
+  void setTargetValue(const float target)
+  {
+    if (target == target_)
+      return;
+
+    target_    = target;
+    origin_    = current_;
+    remaining_ = length_;
+    elapsed_   = 0;
+    step_      = (target_ - origin_) / static_cast<float>(length_);
+  }
+
+  float getCurrentValue() const { return current_; }
+  float getTargetValue() const { return target_; }
+  bool isRamping() const { return remaining_ > 0; }
+
+  // Writes the next numSamples values to dest and advances. Samples past the end of the ramp hold the target.
+  void fill(float* dest, const int numSamples)
+  {
+    const auto count = juce::jmin(numSamples, remaining_);
+    const auto origin = origin_;
+    const auto step   = step_;
+    for (int i = 0; i < count; ++i)
+      dest[i] = origin + step * static_cast<float>(elapsed_ + i + 1);
+    std::fill(dest + count, dest + numSamples, target_);
+
+    advance(count);
+    if (count > 0 && remaining_ == 0)
+      dest[count - 1] = target_;  // land exactly, whatever the rounding in the ramp
+  }
+
+  // Advances without writing the values
+  void skip(const int numSamples) { advance(juce::jmin(numSamples, remaining_)); }
+
+ private:
+  void advance(const int count)
+  {
+    remaining_ -= count;
+    elapsed_   += count;
+    current_    = remaining_ > 0 ? origin_ + step_ * static_cast<float>(elapsed_) : target_;
+  }
+
+  float current_ = 0.0f;
+  float target_  = 0.0f;
+  float origin_  = 0.0f;  // value the ramp set out from
+  float step_    = 0.0f;
+  int remaining_ = 0;
+  int elapsed_   = 0;
+  int length_    = 1;
+};
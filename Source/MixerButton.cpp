@@ -58,8 +58,8 @@ void MixerButton::paint(juce::Graphics& g)
   constexpr auto alphaOne         = 0.3f;
   constexpr auto alphaTwo         = 0.7f;
   constexpr auto halfHandleHeight = kHandleHeight / 2;
-  const auto paramRange           = audioProcessor_.apvts.getParameterRange("MIX");
-  const auto param                = audioProcessor_.apvts.getParameter("MIX");
+  const auto paramRange           = audioProcessor_.apvts.getParameterRange(APParameters::id(APParameters::Mix));
+  const auto param                = audioProcessor_.apvts.getParameter(APParameters::id(APParameters::Mix));
   const auto mappedParamVal       = juce::jmap(param->getValue(), paramRange.start, paramRange.end,
                                                static_cast<float>(getHeight()) - halfHandleHeight, halfHandleHeight);
   const auto barBounds            = juce::Rectangle<float>(sliderWidth, kHandleHeight)
@@ -108,5 +108,5 @@ void MixerButton::mapMouseToValue(const juce::Point<int>& mPoint)
 
   const auto mappedVal  = juce::jmap(static_cast<float>(mPoint.getY()), yMin, yMax, 1.0f, 0.0f);
   const auto limitedVal = juce::jlimit(0.0f, 1.0f, mappedVal);
-  audioProcessor_.apvts.getParameterAsValue("MIX").setValue(limitedVal);
+  audioProcessor_.apvts.getParameterAsValue(APParameters::id(APParameters::Mix)).setValue(limitedVal);
 }
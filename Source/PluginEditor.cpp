@@ -30,11 +30,11 @@ Ap_dynamicsAudioProcessorEditor::Ap_dynamicsAudioProcessorEditor(Ap_dynamicsAudi
 
   // Slider Setup
   setupSlider(thresholdSlider_, thresholdLabel_, "Threshold", SliderType::Invert, "dB");
-  thresholdAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(audioProcessor_.apvts, "THR",
-                                                                                                thresholdSlider_->slider);
+  thresholdAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+      audioProcessor_.apvts, APParameters::id(APParameters::Threshold), thresholdSlider_->slider);
   setupSlider(ratioSlider_, ratioLabel_, "Ratio", SliderType::Normal, ": 1");
-  ratioAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(audioProcessor_.apvts, "RAT",
-                                                                                            ratioSlider_->slider);
+  ratioAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+      audioProcessor_.apvts, APParameters::id(APParameters::Ratio), ratioSlider_->slider);
   auto thresh_look_and_feel = dynamic_cast<MainSliderLookAndFeel*>(&thresholdSlider_->slider.getLookAndFeel());
   jassert(thresh_look_and_feel != nullptr);
   thresh_look_and_feel->getLabelText = [this]()
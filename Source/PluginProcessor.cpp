@@ -18,6 +18,7 @@ Ap_dynamicsAudioProcessor::Ap_dynamicsAudioProcessor()
 #if !JucePlugin_IsMidiEffect
 #if !JucePlugin_IsSynth
                          .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                         .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
                          .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
@@ -26,16 +27,24 @@ Ap_dynamicsAudioProcessor::Ap_dynamicsAudioProcessor()
       ,
       apvts(*this, nullptr, "Parameters", createParameters())
 {
-  compressor_     = std::make_unique<APCompressor>();
-  tubeDistortion_ = std::make_unique<APTubeDistortion>();
-  overdrive_      = std::make_unique<APOverdrive>();
-  postHighPass_   = std::make_unique<Filter>();
-  postLowPass_    = std::make_unique<Filter>();
+  multiband_ = std::make_unique<APMultibandCompressor>();
 
-  apvts.state.addListener(this);
+  for (const auto& parameter : APParameters::REGISTRY)
+  {
+    parameters_[static_cast<size_t>(parameter.index)] = apvts.getRawParameterValue(parameter.id);
+    auto& flag                                        = parameterFlags_[static_cast<size_t>(parameter.index)];
+    flag.owner                                        = this;
+    flag.mask                                         = bit(parameter.index);
+    apvts.addParameterListener(parameter.id, &flag);
+  }
 }
 
-Ap_dynamicsAudioProcessor::~Ap_dynamicsAudioProcessor() = default;
+Ap_dynamicsAudioProcessor::~Ap_dynamicsAudioProcessor()
+{
+  cancelPendingUpdate();
+  for (const auto& parameter : APParameters::REGISTRY)
+    apvts.removeParameterListener(parameter.id, &parameterFlags_[static_cast<size_t>(parameter.index)]);
+}
 
 //==============================================================================
 const juce::String Ap_dynamicsAudioProcessor::getName() const { return JucePlugin_Name; }
@@ -67,7 +76,7 @@ bool Ap_dynamicsAudioProcessor::isMidiEffect() const
 #endif
 }
 
-double Ap_dynamicsAudioProcessor::getTailLengthSeconds() const { return 0.0; }
+double Ap_dynamicsAudioProcessor::getTailLengthSeconds() const { return tailLengthSeconds_.load(); }
 
 int Ap_dynamicsAudioProcessor::getNumPrograms()
 {
@@ -108,19 +117,46 @@ void Ap_dynamicsAudioProcessor::prepareToPlay(double sampleRate, int samplesPerB
   auto channels = static_cast<uint32>(jmin(getMainBusNumInputChannels(), getMainBusNumOutputChannels()));
   dsp::ProcessSpec spec{ sampleRate, static_cast<uint32>(samplesPerBlock), channels };
 
-  //  tubeDistortion_->prepare(spec);
+  forEachChain([&](auto& chain) {
+    using SampleType = typename std::decay_t<decltype(chain)>::Sample;
+
+    chain.postHighPass->prepare(spec);
+    chain.postLowPass->prepare(spec);
+
+    const auto rh = SampleType(0.98);
+    const auto r1 = SampleType(0.8);
 
-  postHighPass_->prepare(spec);
-  postLowPass_->prepare(spec);
+    *chain.postHighPass->state =
+        dsp::IIR::Coefficients<SampleType>(SampleType(1), SampleType(-2), SampleType(1), SampleType(1), -2 * rh, rh * rh);
+    *chain.postLowPass->state =
+        dsp::IIR::Coefficients<SampleType>(1 - r1, SampleType(0), SampleType(0), SampleType(1), -r1, SampleType(0));
 
-  auto rh = 0.98f;
-  auto r1 = 0.8f;
+    chain.mixBuffer.setSize(static_cast<int>(channels), samplesPerBlock);
+    chain.inputPointers.resize(static_cast<size_t>(jmax(1, getMainBusNumInputChannels())));
+    chain.keyPointers.resize(chain.inputPointers.size());
+    chain.outputPointers.resize(chain.inputPointers.size());
+    chain.compressor->prepare(static_cast<float>(sampleRate), static_cast<int>(channels));
+    chain.overdrive->prepare(static_cast<int>(channels));
+    chain.tubeDistortion->prepare(static_cast<float>(sampleRate), static_cast<int>(channels));
 
-  *postHighPass_->state = dsp::IIR::Coefficients<float>(1.0f, -2.0f, 1.0f, 1.0f, -2.0f * rh, powf(rh, 2.0f));
-  *postLowPass_->state  = dsp::IIR::Coefficients<float>(1.0f - r1, 0.0f, 0.0f, 1.0f, -r1, 0.0f);
+    // Saturators run a tile at a time, and the dry path can wait on both of them at their longest delay
+    using Oversampler = typename std::decay_t<decltype(chain)>::Oversampler;
+    chain.overdriveOversampler->prepare(static_cast<int>(channels), TILE_SIZE);
+    chain.tubeOversampler->prepare(static_cast<int>(channels), TILE_SIZE);
+    chain.dryDelay.setSize(static_cast<int>(channels),
+                           2 * Oversampler::getLatencySamples(Oversampler::MAX_STAGES, Oversampler::Phase::Linear) +
+                               APTubeDistortion<float>::ANTIALIASING_LATENCY);
+  });
 
-  mixBuffer_.setSize(static_cast<int>(channels), samplesPerBlock);
-  compressor_->setSampleRate(static_cast<float>(sampleRate));
+  rampBuffer_.setSize(NumRampChannels, samplesPerBlock);
+  oversampledRamps_.setSize(3, TILE_SIZE * APOversampler<float>::MAX_FACTOR);
+  for (auto* ramp : { &dryGain_, &wetGain_, &makeup_, &distQ_, &distChar_, &overdriveMix_ })
+    ramp->reset(sampleRate, APConstants::Math::PARAMETER_RAMP_TIME);
+  multiband_->prepare(static_cast<float>(sampleRate), static_cast<int>(channels));
+  multibandBuffer_.setSize(1, samplesPerBlock);
+  updateCompressorCurve();
+  updateLatency();
+  audioDirty_ = 0;  // changes from here on are picked up by the next block
   update();
   reset();
   isActive_ = true;
@@ -139,16 +175,26 @@ bool Ap_dynamicsAudioProcessor::isBusesLayoutSupported(const BusesLayout& layout
   juce::ignoreUnused(layouts);
   return true;
 #else
-  // This is the place where you check if the layout is supported.
-  // In this template code we only support mono or stereo.
-  if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono() &&
-      layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+  // Mono, stereo and the surround layouts up to 7.1.4
+  const auto main = layouts.getMainOutputChannelSet();
+  if (main != juce::AudioChannelSet::mono() && main != juce::AudioChannelSet::stereo() &&
+      main != juce::AudioChannelSet::create5point1() && main != juce::AudioChannelSet::create7point1() &&
+      main != juce::AudioChannelSet::create7point1point4())
     return false;
 
     // This checks if the input layout matches the output layout
 #if !JucePlugin_IsSynth
   if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
     return false;
+
+  // Optional sidechain: disabled, mono, stereo or the main layout
+  if (layouts.inputBuses.size() > 1)
+  {
+    const auto sidechain = layouts.getChannelSet(true, 1);
+    if (!sidechain.isDisabled() && sidechain != juce::AudioChannelSet::mono() &&
+        sidechain != juce::AudioChannelSet::stereo() && sidechain != main)
+      return false;
+  }
 #endif
 
   return true;
@@ -160,83 +206,366 @@ void Ap_dynamicsAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, j
 {
   // Unused Parameters
   ignoreUnused(midiMessages);
+  processSamples(buffer);
+}
+
+void Ap_dynamicsAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+  // Unused Parameters
+  ignoreUnused(midiMessages);
+  processSamples(buffer);
+}
 
+template <typename SampleType>
+void Ap_dynamicsAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
+{
   if (!isActive_)
     return;
-  if (mustUpdateProcessing_)
-    update();
+  // Offline renders may run without a message loop to deliver the async update, and have time to spare for it
+  if (isNonRealtime())
+    handleAsyncUpdate();
+  if (const auto changed = audioDirty_.exchange(0, std::memory_order_acquire))
+    update(changed);
 
   juce::ScopedNoDenormals noDenormals;
-  juce::dsp::AudioBlock<float> block(buffer);
-  juce::dsp::ProcessContextReplacing<float> context(block);
 
-  const auto totalNumInputChannels  = getTotalNumInputChannels();
-  const auto totalNumOutputChannels = getTotalNumOutputChannels();
-  const auto numChannels            = juce::jmin(totalNumInputChannels, totalNumOutputChannels);
+  // The sidechain shares the host buffer, so only the main bus channels are processed
+  const auto mainNumInputChannels   = getMainBusNumInputChannels();
+  const auto mainNumOutputChannels  = getMainBusNumOutputChannels();
+  const auto numChannels            = juce::jmin(mainNumInputChannels, mainNumOutputChannels);
   const auto numSamples             = buffer.getNumSamples();
 
+  auto& chain = getChain<SampleType>();
+
+  juce::dsp::AudioBlock<SampleType> block(buffer);
+  auto mainBlock = block.getSubsetChannelBlock(0, static_cast<size_t>(numChannels));
+
+  // Sidechain key, read straight from the host's channel pointers
+  const auto sidechain            = getBusBuffer(buffer, true, 1);
+  const auto numSidechainChannels = sidechain.getNumChannels();  // 0 while the bus is disabled
+
+  for (auto i = mainNumInputChannels; i < mainNumOutputChannels; ++i)
+  {
+    buffer.clear(i, 0, numSamples);
+  }
+
+  // One min/max scan per channel feeds the meter and the silence check
   auto sumMaxVal     = 0.0f;
   auto currentMaxVal = meterGlobalMaxVal.load();
+  auto silent        = true;
+
+  // In M/S the encode rides on this scan, which sees L/R
+  const auto midSide = midSide_ && mainNumInputChannels == 2 && numChannels == 2;
+  juce::Range<SampleType> leftRight[2];
+  if (midSide)
+    encodeMidSide(buffer.getWritePointer(0), buffer.getWritePointer(1), numSamples, leftRight);
 
-  for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+  for (int channel = 0; channel < mainNumInputChannels; ++channel)
   {
-    buffer.clear(i, 0, numSamples);
+    const auto range         = midSide ? leftRight[channel] : buffer.findMinMax(channel, 0, numSamples);
+    const auto channelMaxVal = static_cast<float>(juce::jmax(-range.getStart(), range.getEnd()));
+
+    sumMaxVal     += channelMaxVal;  // Sum of channel 0 and channel 1 max values
+    currentMaxVal  = juce::jmax(currentMaxVal, channelMaxVal);
+    silent         = silent && channelMaxVal == 0.0f;
+  }
+  meterGlobalMaxVal = currentMaxVal;
+  for (int channel = 0; silent && channel < numSidechainChannels; ++channel)
+    silent = sidechain.findMinMax(channel, 0, numSamples) == juce::Range<SampleType>();
+
+  // Past the tail of the last sound, zeros in give zeros out (the post filters' residue is below -120 dB) and the
+  // detectors have released. Reset once to the state they were decaying towards and only keep the ramps moving.
+  silentSamples_ = silent ? juce::jmin(silentSamples_ + numSamples, silenceTailSamples_ + 1) : 0;
+  if (silentSamples_ > silenceTailSamples_)
+  {
+    if (!idle_)
+    {
+      idle_ = true;
+      resetDSP();
+    }
+    for (auto* ramp : { &dryGain_, &wetGain_, &makeup_, &distQ_, &distChar_, &overdriveMix_ })
+      ramp->skip(numSamples);
+    meterLocalMaxVal = 0.0f;
+    return;
+  }
+  idle_ = false;
+
+  // Every ramp is filled for the whole block up front and shared by every channel and tile, so the tile size never
+  // changes a ramp's values
+  const float* distQRamp    = nullptr;
+  const float* distCharRamp = nullptr;
+  if (distQ_.isRamping() || distChar_.isRamping())
+  {
+    distQ_.fill(rampBuffer_.getWritePointer(DistQRamp), numSamples);
+    distChar_.fill(rampBuffer_.getWritePointer(DistCharRamp), numSamples);
+    distQRamp    = rampBuffer_.getReadPointer(DistQRamp);
+    distCharRamp = rampBuffer_.getReadPointer(DistCharRamp);
+  }
+  const float* overdriveMixRamp = nullptr;
+  if (overdriveMix_.isRamping())
+  {
+    overdriveMix_.fill(rampBuffer_.getWritePointer(OverdriveMixRamp), numSamples);
+    overdriveMixRamp = rampBuffer_.getReadPointer(OverdriveMixRamp);
+  }
+
+  // With either side of the mix settled at zero its whole path is skipped: no dry copy at mix 1, no wet stages, filters
+  // or wet gain at mix 0
+  const auto dryActive = dryGain_.isRamping() || dryGain_.getCurrentValue() != 0.0f;
+  const auto wetActive = wetGain_.isRamping() || wetGain_.getCurrentValue() != 0.0f;
+
+  // Only one side live: the buffer already holds it and the muted side's ramp just moves on
+  const auto dryLive = dryActive || !wetActive;
+  const auto dryGain = dryLive ? prepareGain(dryGain_, DryRamp, numSamples) : skipGain(dryGain_, numSamples);
+  const auto wetGain = wetActive ? prepareGain(wetGain_, WetRamp, numSamples) : skipGain(wetGain_, numSamples);
+  const auto makeup  = prepareGain(makeup_, MakeupRamp, numSamples);
+
+  const auto filtersActive = wetActive && !isBypassed(Stage::Filters);
+  if (!filtersActive && !filtersBypassed_)
+  {
+    // The filters stop here; clear them so they start again from silence rather than stale state
+    chain.postHighPass->reset();
+    chain.postLowPass->reset();
   }
+  filtersBypassed_ = !filtersActive;
 
-  // Mix Buffer Feeding
-//  for (auto channel = 0; channel < numChannels; channel++)
-//    mixBuffer_.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+  BlockContext<SampleType> context { chain,
+                                     buffer,
+                                     sidechain,
+                                     mainBlock,
+                                     mainNumInputChannels,
+                                     numChannels,
+                                     numSidechainChannels,
+                                     midSide,
+                                     dryActive,
+                                     wetActive,
+                                     filtersActive,
+                                     dryGain,
+                                     wetGain,
+                                     makeup,
+                                     distQRamp,
+                                     distCharRamp,
+                                     overdriveMixRamp };
+  std::visit([&](const auto order) { processTiles(order, context, numSamples); }, stageOrder_);
 
-  for (int channel = 0; channel < totalNumInputChannels; ++channel)
+  meterLocalMaxVal = sumMaxVal / static_cast<float>(numChannels);
+}
+
+template <typename SampleType, Ap_dynamicsAudioProcessor::Stage... Stages>
+void Ap_dynamicsAudioProcessor::processTiles(StageList<Stages...>, BlockContext<SampleType>& context,
+                                             const int numSamples)
+{
+  auto& buffer      = context.buffer;
+  auto& mixBuffer   = context.chain.mixBuffer;
+  const auto numOut = context.numChannels;
+
+  // Each tile goes through the whole chain while it is in cache
+  for (int start = 0; start < numSamples; start += TILE_SIZE)
   {
-    auto* channelData = buffer.getWritePointer(channel);
+    const auto tileSize = juce::jmin(TILE_SIZE, numSamples - start);
+
+    (processStage<Stages, StageList<Stages...>::isWet(Stages)>(context, start, tileSize), ...);
 
+    // Mix Processing
+    if (context.dryActive && context.wetActive)
     {
-      // Find the channel max gain value
-      auto channelMaxVal = 0.0f;
+      applyGain(context.dryGain, mixBuffer, numOut, start, tileSize);
+      applyGain(context.wetGain, buffer, numOut, start, tileSize);
 
-      for (int sample = 0; sample < numSamples; ++sample)
+      // -- Convolution
+      for (auto channel = 0; channel < numOut; channel++)
+        buffer.addFrom(channel, start, mixBuffer, channel, start, tileSize);
+    }
+    else
+    {
+      applyGain(context.wetActive ? context.wetGain : context.dryGain, buffer, numOut, start, tileSize);
+    }
+
+    // Makeup
+    if (context.midSide)
+      decodeMidSide(context.makeup, buffer, start, tileSize);
+    else
+      applyGain(context.makeup, buffer, numOut, start, tileSize);
+  }
+}
+
+template <Ap_dynamicsAudioProcessor::Stage stage, bool wet, typename SampleType>
+void Ap_dynamicsAudioProcessor::processStage(BlockContext<SampleType>& context, const int start,
+                                             const int numSamples)
+{
+  if constexpr (wet)
+    if (!context.wetActive)
+      return;
+
+  auto& chain             = context.chain;
+  auto& buffer            = context.buffer;
+  const auto numChannels  = context.numInputChannels;
+  const auto numSidechain = context.numSidechainChannels;
+
+  if constexpr (stage == Stage::Compressor)
+  {
+    if (!isBypassed(Stage::Compressor))
+    {
+      if (multibandEnabled_)
       {
-        auto rectifiedVal = std::abs(channelData[sample]);
-        if (channelMaxVal < rectifiedVal)
-          channelMaxVal = rectifiedVal;
-        if (currentMaxVal < rectifiedVal)
-          currentMaxVal = rectifiedVal;
+        // Bands key themselves
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+          auto* channelData = buffer.getWritePointer(channel, start);
+          if constexpr (std::is_same_v<SampleType, float>)
+          {
+            multiband_->process(channel, channelData, channelData, numSamples);
+          }
+          else
+          {
+            auto* bandData = multibandBuffer_.getWritePointer(0);
+            std::copy(channelData, channelData + numSamples, bandData);
+            multiband_->process(channel, bandData, bandData, numSamples);
+            std::copy(bandData, bandData + numSamples, channelData);
+          }
+        }
       }
+      else
+      {
+        // One compressor call per link group, so a linked detector sees the group's whole frame
+        for (int index = 0; index < numChannels; ++index)
+        {
+          const auto channel = linkOrder_[static_cast<size_t>(index)];
+          chain.inputPointers[static_cast<size_t>(index)]  = buffer.getReadPointer(channel, start);
+          chain.outputPointers[static_cast<size_t>(index)] = buffer.getWritePointer(channel, start);
+          if (numSidechain > 0)
+            chain.keyPointers[static_cast<size_t>(index)] =
+                context.sidechain.getReadPointer(juce::jmin(channel, numSidechain - 1), start);
+        }
+        for (int group = 0; group < numLinkGroups_; ++group)
+        {
+          const auto [first, count] = linkGroups_[static_cast<size_t>(group)];
+          chain.compressor->process(chain.inputPointers.data() + first,
+                                    numSidechain > 0 ? chain.keyPointers.data() + first : nullptr,
+                                    chain.outputPointers.data() + first, first, count, numSamples);  // comp -> ok
+        }
+      }
+    }
+
+    // The dry path taps the compressor output, so it already carries the lookahead delay
+    if (context.dryActive)
+      delayDry(context, start, numSamples);
+  }
+  else if constexpr (stage == Stage::Overdrive)
+  {
+    if (isBypassed(Stage::Overdrive))
+      return;
 
-      sumMaxVal += channelMaxVal;  // Sum of channel 0 and channel 1 max values
+    const auto* mixRamp = context.overdriveMixRamp;
+    if (mixRamp != nullptr)
+      mixRamp = holdRamp(mixRamp, 2, start, numSamples, chain.overdriveOversampler->getFactor());
 
-      meterGlobalMaxVal = currentMaxVal;
+    processSaturator(context, *chain.overdriveOversampler, start, numSamples,
+                     [&](const int channel, SampleType* data, const int count) {
+                       if (mixRamp != nullptr)
+                         chain.overdrive->process(channel, data, mixRamp, data, count);
+                       else
+                         chain.overdrive->process(channel, data, data, count);
+                     });
+  }
+  else if constexpr (stage == Stage::Tube)
+  {
+    if (isBypassed(Stage::Tube))
+      return;
+
+    const float* distQRamp    = context.distQRamp;
+    const float* distCharRamp = context.distCharRamp;
+    if (distQRamp != nullptr)
+    {
+      const auto factor = chain.tubeOversampler->getFactor();
+      distQRamp         = holdRamp(distQRamp, 0, start, numSamples, factor);
+      distCharRamp      = holdRamp(distCharRamp, 1, start, numSamples, factor);
     }
 
-    // Find the buffer's max magnitude
-    const auto bufferMinMax = buffer.findMinMax(channel, 0, numSamples);
+    processSaturator(context, *chain.tubeOversampler, start, numSamples,
+                     [&](const int channel, SampleType* data, const int count) {
+                       if (distQRamp != nullptr)
+                         chain.tubeDistortion->process(channel, data, 1.0f, distQRamp, distCharRamp, data, count);
+                       else
+                         chain.tubeDistortion->process(channel, data, 1.0f, distQ_.getCurrentValue(),
+                                                       distChar_.getCurrentValue(), data, count);
+                     });
+  }
+  else if constexpr (stage == Stage::Filters)
+  {
+    if (!context.filtersActive)
+      return;
 
-    // DSP Processing
-    compressor_->process(channelData, channelData, buffer.getNumSamples());  // comp -> ok
-    //    overdrive_->process(channelData, channelData, buffer.getNumSamples());
-    mixBuffer_.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+    // Post-Filtering
+    auto tile = context.mainBlock.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(numSamples));
+    juce::dsp::ProcessContextReplacing<SampleType> filterContext(tile);
+    chain.postHighPass->process(filterContext);
+    chain.postLowPass->process(filterContext);
+  }
+}
+
+template <typename SampleType, typename Process>
+void Ap_dynamicsAudioProcessor::processSaturator(BlockContext<SampleType>& context,
+                                                 APOversampler<SampleType>& oversampler, const int start,
+                                                 const int numSamples, Process&& process)
+{
+  auto& buffer           = context.buffer;
+  const auto numChannels = context.numInputChannels;
 
-    tubeDistortion_->process(channelData, bufferMinMax.getStart(), bufferMinMax.getEnd(), 1.0f, distQ_, distChar_,
-                             channelData, buffer.getNumSamples());
+  if (!oversampler.isEnabled())
+  {
+    for (int channel = 0; channel < numChannels; ++channel)
+      process(channel, buffer.getWritePointer(channel, start), numSamples);
+    return;
   }
 
-  // Post-Filtering
-  postHighPass_->process(context);
-  postLowPass_->process(context);
+  // Every channel goes up and down together, one per SIMD lane of the filters
+  auto& pointers = context.chain.outputPointers;
+  for (int channel = 0; channel < numChannels; ++channel)
+    pointers[static_cast<size_t>(channel)] = buffer.getWritePointer(channel, start);
 
-  // Mix Processing
-  dryGain_.applyGain(mixBuffer_, numSamples);
-  wetGain_.applyGain(buffer, numSamples);
+  oversampler.upsample(pointers.data(), numChannels, numSamples);
+  for (int channel = 0; channel < numChannels; ++channel)
+    process(channel, oversampler.getOversampledChannel(channel), numSamples * oversampler.getFactor());
+  oversampler.downsample(pointers.data(), numChannels, numSamples);
+}
 
-  // -- Convolution
-  for (auto channel = 0; channel < numChannels; channel++)
-    buffer.addFrom(channel, 0, mixBuffer_,  channel, 0, numSamples);
+template <typename SampleType>
+void Ap_dynamicsAudioProcessor::delayDry(BlockContext<SampleType>& context, const int start, const int numSamples)
+{
+  auto& chain            = context.chain;
+  auto& buffer           = context.buffer;
+  const auto numChannels = context.numInputChannels;
+  const auto delay       = dryDelaySamples_;
 
-  // Makeup
-  makeup_.applyGain(buffer, numSamples);
+  // Only the dry side live: the buffer is the output, and needs no delay unless the wet side would have had one
+  if (!context.wetActive && delay == 0)
+    return;
+  auto& dry = context.wetActive ? chain.mixBuffer : buffer;
 
-  meterLocalMaxVal = sumMaxVal / static_cast<float>(numChannels);
+  if (delay == 0)
+  {
+    for (int channel = 0; channel < numChannels; ++channel)
+      dry.copyFrom(channel, start, buffer, channel, start, numSamples);
+    return;
+  }
+
+  auto position = chain.dryDelayPosition;
+  for (int channel = 0; channel < numChannels; ++channel)
+  {
+    const auto* source = buffer.getReadPointer(channel, start);
+    auto* dest         = dry.getWritePointer(channel, start);
+    auto* line         = chain.dryDelay.getWritePointer(channel);
+    position           = chain.dryDelayPosition;
+    for (int i = 0; i < numSamples; ++i)
+    {
+      const auto sample = source[i];  // before the write, which may be to the same sample
+      dest[i]           = line[position];
+      line[position]    = sample;
+      if (++position == delay)
+        position = 0;
+    }
+  }
+  chain.dryDelayPosition = position;
 }
 
 //==============================================================================
@@ -261,41 +590,415 @@ void Ap_dynamicsAudioProcessor::setStateInformation(const void* data, int sizeIn
   auto xml             = getXmlFromBinary(data, sizeInBytes);
   const auto copyState = juce::ValueTree::fromXml(*xml);
   apvts.replaceState(copyState);
+  // The listeners only flag parameters whose value moved, so the curve and latency are rebuilt for the whole state
+  updateCompressorCurve();
+  updateLatency();
 }
 
-void Ap_dynamicsAudioProcessor::update()
+void Ap_dynamicsAudioProcessor::update(const uint64_t changed)
 {
-  mustUpdateProcessing_ = false;
-  const auto mix        = apvts.getRawParameterValue("MIX")->load();
-  dryGain_.setCurrentAndTargetValue(1.0f - mix);
-  wetGain_.setCurrentAndTargetValue(mix);
+  using namespace APParameters;
 
-  compressor_->updateParameters(apvts.getRawParameterValue("THR")->load(), apvts.getRawParameterValue("RAT")->load());
-  overdrive_->updateParameters(mix);
+  for (int parameter = 0; parameter < NumParameters; ++parameter)
+    if ((changed & bit(parameter)) != 0)
+      snapshot_[static_cast<size_t>(parameter)] = parameters_[static_cast<size_t>(parameter)]->load();
 
-  distQ_.store(apvts.getRawParameterValue(APParameters::DISTQ_ID)->load());
-  distChar_.store(apvts.getRawParameterValue(APParameters::DIST_CHAR_ID)->load());
+  const auto& value  = snapshot_;
+  const auto touched = [changed](const uint64_t mask) { return (changed & mask) != 0; };
+  const auto choice  = [&value](const Parameter parameter) {
+    return juce::roundToInt(value[static_cast<size_t>(parameter)]);
+  };
 
-  const auto makeup =
-      juce::Decibels::decibelsToGain(apvts.getRawParameterValue(APParameters::MAKEUP_ID)->load(), APConstants::Math::MINUS_INF_DB);
-  makeupSmoothed_ = makeupSmoothed_ - 0.004f * (makeupSmoothed_ - makeup);
-  makeup_.setCurrentAndTargetValue(makeupSmoothed_);
+  if (touched(bit(Mix)))
+  {
+    dryGain_.setTargetValue(1.0f - value[Mix]);
+    wetGain_.setTargetValue(value[Mix]);
+    overdriveMix_.setTargetValue(value[Mix]);
+  }
+
+  forEachChain([&](auto& chain) {
+    auto& compressor = *chain.compressor;
+    if (touched(bit(Attack)))
+      compressor.setAttack(value[Attack] * 0.001f);
+    if (touched(bit(Release)))
+      compressor.setRelease(value[Release] * 0.001f);
+    if (touched(bit(Lookahead)))
+      compressor.setLookahead(value[Lookahead] * 0.001f);
+    if (touched(bit(Detector)))
+      compressor.setDetector(static_cast<APCompressorBase::Detector>(choice(Detector)));
+    if (touched(bit(Topology)))
+      compressor.setTopology(static_cast<APCompressorBase::Topology>(choice(Topology)));
+    if (touched(bit(Character)))
+      compressor.setCharacter(static_cast<APCompressorBase::Character>(choice(Character)));
+    if (touched(bit(ControlRate)))
+      compressor.setControlInterval(CONTROL_RATE_INTERVALS[static_cast<size_t>(choice(ControlRate))]);
+    if (touched(bit(StereoLink)))
+      compressor.setChannelLink(static_cast<APCompressorBase::ChannelLink>(choice(StereoLink)));
+    if (touched(bit(RMSWindow)))
+      compressor.setRMSWindow(value[RMSWindow] * 0.001f);
+    if (touched(bit(KeyFilter) | bit(KeyFilterFreq)))
+      compressor.setKeyFilter(value[KeyFilter] >= 0.5f, value[KeyFilterFreq]);
+    if (touched(bit(Mix) | bit(Antialiasing)))
+      chain.overdrive->updateParameters(value[Mix], value[Antialiasing] >= 0.5f);
+    if (touched(bit(Antialiasing)))
+      chain.tubeDistortion->setAntialiasing(value[Antialiasing] >= 0.5f);
+  });
+
+  if (touched(bit(StageOrder)))
+    stageOrder_ = makeStageOrder(choice(StageOrder), std::make_index_sequence<std::variant_size_v<StageOrders>>());
+  if (touched(bit(BypassCompressor) | bit(BypassOverdrive) | bit(BypassTube) | bit(BypassFilters)))
+  {
+    // A compressor coming back starts from rest rather than from the level it last saw
+    if (isBypassed(Stage::Compressor) && value[BypassCompressor] < 0.5f)
+    {
+      forEachChain([](auto& chain) { chain.compressor->reset(); });
+      multiband_->reset();
+    }
+    // Likewise a saturator's filters, rather than from the signal it last saw
+    if (isBypassed(Stage::Overdrive) && value[BypassOverdrive] < 0.5f)
+      forEachChain([](auto& chain) { chain.overdriveOversampler->reset(); });
+    if (isBypassed(Stage::Tube) && value[BypassTube] < 0.5f)
+      forEachChain([](auto& chain) { chain.tubeOversampler->reset(); });
+    bypassed_ = { value[BypassCompressor] >= 0.5f, value[BypassOverdrive] >= 0.5f, value[BypassTube] >= 0.5f,
+                  value[BypassFilters] >= 0.5f };
+  }
+
+  if (touched(bit(Oversampling) | bit(OversamplingPhase) | bit(StageOrder) | bit(BypassOverdrive) | bit(BypassTube) |
+              bit(Antialiasing)))
+  {
+    const auto stages = choice(Oversampling);
+    const auto phase  = choice(OversamplingPhase);
+    forEachChain([&](auto& chain) {
+      using Phase = typename std::decay_t<decltype(chain)>::Oversampler::Phase;
+      chain.overdriveOversampler->setup(stages, static_cast<Phase>(phase));
+      chain.tubeOversampler->setup(stages, static_cast<Phase>(phase));
+      // The tube's envelope releases in time, at whichever rate it runs
+      chain.tubeDistortion->setSampleRate(static_cast<float>(getSampleRate()) * chain.tubeOversampler->getFactor());
+    });
+
+    // The dry path waits for the oversampled saturators after the compressor, those before it delay both paths
+    using Oversampler  = APOversampler<float>;
+    const auto latency = Oversampler::getLatencySamples(stages, static_cast<Oversampler::Phase>(phase));
+    const auto isWet   = [this](const Stage stage) {
+      return std::visit([stage](const auto order) { return decltype(order)::isWet(stage); }, stageOrder_);
+    };
+    const auto antialiasing = tubeAntialiasingLatency(stages, value[Antialiasing] >= 0.5f);
+    auto dryDelay           = 0;
+    saturatorLatency_       = 0;
+    for (const auto stage : { Stage::Overdrive, Stage::Tube })
+    {
+      if (isBypassed(stage))
+        continue;
+      const auto stageLatency = latency + (stage == Stage::Tube ? antialiasing : 0);
+      saturatorLatency_ += stageLatency;
+      dryDelay += isWet(stage) ? stageLatency : 0;
+    }
+    if (dryDelay != dryDelaySamples_)
+    {
+      dryDelaySamples_ = dryDelay;
+      forEachChain([](auto& chain) {
+        chain.dryDelay.clear();
+        chain.dryDelayPosition = 0;
+      });
+    }
+  }
+
+  if (touched(bit(StereoMode)))
+    midSide_ = value[StereoMode] >= 0.5f;
+  if (touched(bit(StereoLink) | bit(LinkGroups)))
+    updateLinkGroups();
+
+  // Multiband shares the single band's curve and timing, each band with its own detector. Its settings are left
+  // alone while it is off, so switching it on brings all of them up to date.
+  const auto bands  = choice(Bands);
+  multibandEnabled_ = bands > 0;
+  if (multibandEnabled_)
+  {
+    const auto all = touched(bit(Bands));
+    if (all || touched(bit(XoverLow) | bit(XoverMid) | bit(XoverHigh)))
+    {
+      multiband_->setNumBands(bands + 2);
+      multiband_->setCrossovers(value[XoverLow], value[XoverMid], value[XoverHigh]);
+    }
+    if (all || touched(bit(Attack)))
+      multiband_->setAttack(value[Attack] * 0.001f);
+    if (all || touched(bit(Release)))
+      multiband_->setRelease(value[Release] * 0.001f);
+    if (all || touched(bit(Threshold) | bit(Ratio) | bit(Knee)))
+      multiband_->updateParameters(value[Threshold], value[Ratio], value[Knee]);
+  }
+
+  // Silence long enough for the output tail to ring out and the detectors and the tube's envelope to let go of the
+  // last sound
+  if (touched(bit(Lookahead) | bit(RMSWindow) | bit(Release) | bit(Bands) | bit(Oversampling) |
+              bit(OversamplingPhase) | bit(BypassOverdrive) | bit(BypassTube) | bit(Antialiasing)))
+  {
+    const auto settleTime = value[Lookahead] * 0.001 + value[RMSWindow] * 0.001 +
+                            value[Release] * 0.001 * APConstants::Math::RELEASE_SETTLE_TIMES +
+                            (multibandEnabled_ ? APConstants::Math::CROSSOVER_TAIL : 0.0) +
+                            (isBypassed(Stage::Tube) ? 0.0 : APTubeDistortion<float>::ENVELOPE_SETTLE_TIME);
+    // saturatorLatency_ holds the tube's anti-aliasing delay too, so Antialiasing is among the bits above
+    silenceTailSamples_ = juce::roundToInt(settleTime * getSampleRate()) + saturatorLatency_ +
+                          APConstants::Math::POST_FILTER_TAIL_SAMPLES;
+  }
+
+  if (touched(bit(DistQ)))
+    distQ_.setTargetValue(value[DistQ]);
+  if (touched(bit(DistChar)))
+    distChar_.setTargetValue(value[DistChar]);
+  if (touched(bit(Makeup)))
+    makeup_.setTargetValue(juce::Decibels::decibelsToGain(value[Makeup], APConstants::Math::MINUS_INF_DB));
+}
+
+Ap_dynamicsAudioProcessor::BlockGain Ap_dynamicsAudioProcessor::prepareGain(APParameterRamp& gain,
+                                                                           const RampChannel channel,
+                                                                           const int numSamples)
+{
+  if (!gain.isRamping())
+    return { gain.getCurrentValue(), nullptr };
+
+  auto* ramp = rampBuffer_.getWritePointer(channel);
+  gain.fill(ramp, numSamples);
+  return { gain.getTargetValue(), ramp };
+}
+
+Ap_dynamicsAudioProcessor::BlockGain Ap_dynamicsAudioProcessor::skipGain(APParameterRamp& gain, const int numSamples)
+{
+  gain.skip(numSamples);
+  return { gain.getCurrentValue(), nullptr };
+}
+
+const float* Ap_dynamicsAudioProcessor::holdRamp(const float* ramp, const int channel, const int start,
+                                                 const int numSamples, const int factor)
+{
+  if (factor == 1)
+    return ramp + start;
+
+  auto* held = oversampledRamps_.getWritePointer(channel);
+  for (int i = 0; i < numSamples; ++i)
+    std::fill_n(held + i * factor, factor, ramp[start + i]);
+  return held;
+}
+
+template <typename SampleType>
+void Ap_dynamicsAudioProcessor::applyGain(const BlockGain& gain, juce::AudioBuffer<SampleType>& buffer,
+                                          const int numChannels, const int start, const int numSamples)
+{
+  if (gain.ramp == nullptr)
+  {
+    const auto value = static_cast<SampleType>(gain.value);
+    if (value != SampleType(1))
+      for (auto channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::multiply(buffer.getWritePointer(channel, start), value, numSamples);
+    return;
+  }
+
+  const auto* ramp = gain.ramp + start;
+  for (auto channel = 0; channel < numChannels; ++channel)
+  {
+    auto* data = buffer.getWritePointer(channel, start);
+    if constexpr (std::is_same_v<SampleType, float>)
+      juce::FloatVectorOperations::multiply(data, ramp, numSamples);
+    else
+      for (auto i = 0; i < numSamples; ++i)
+        data[i] *= static_cast<SampleType>(ramp[i]);
+  }
+}
+
+template <typename SampleType>
+void Ap_dynamicsAudioProcessor::encodeMidSide(SampleType* left, SampleType* right, const int numSamples,
+                                              juce::Range<SampleType>* leftRight)
+{
+  if (numSamples <= 0)
+  {
+    leftRight[0] = leftRight[1] = {};
+    return;
+  }
+
+  auto minL = left[0], maxL = left[0], minR = right[0], maxR = right[0];
+  for (auto i = 0; i < numSamples; ++i)
+  {
+    const auto l = left[i];
+    const auto r = right[i];
+
+    minL = juce::jmin(minL, l);
+    maxL = juce::jmax(maxL, l);
+    minR = juce::jmin(minR, r);
+    maxR = juce::jmax(maxR, r);
+
+    left[i]  = (l + r) / 2;
+    right[i] = (l - r) / 2;
+  }
+
+  leftRight[0] = { minL, maxL };
+  leftRight[1] = { minR, maxR };
+}
+
+template <typename SampleType>
+void Ap_dynamicsAudioProcessor::decodeMidSide(const BlockGain& gain, juce::AudioBuffer<SampleType>& buffer,
+                                              const int start, const int numSamples)
+{
+  auto* mid  = buffer.getWritePointer(0, start);
+  auto* side = buffer.getWritePointer(1, start);
+
+  if (gain.ramp == nullptr)
+  {
+    const auto value = static_cast<SampleType>(gain.value);
+    for (auto i = 0; i < numSamples; ++i)
+    {
+      const auto m = mid[i];
+      const auto s = side[i];
+      mid[i]       = (m + s) * value;
+      side[i]      = (m - s) * value;
+    }
+    return;
+  }
+
+  const auto* ramp = gain.ramp + start;
+  for (auto i = 0; i < numSamples; ++i)
+  {
+    const auto m     = mid[i];
+    const auto s     = side[i];
+    const auto value = static_cast<SampleType>(ramp[i]);
+    mid[i]           = (m + s) * value;
+    side[i]          = (m - s) * value;
+  }
+}
+
+void Ap_dynamicsAudioProcessor::updateLinkGroups()
+{
+  enum Role { Front, Surround, Height, LFE, NumRoles };
+
+  const auto layout      = getChannelLayoutOfBus(true, 0);
+  const auto numChannels = juce::jlimit(0, MAX_CHANNELS, getMainBusNumInputChannels());
+  const auto linked      = juce::roundToInt(snapshot_[APParameters::StereoLink]) != 0;
+  const auto groups      = juce::roundToInt(snapshot_[APParameters::LinkGroups]);
+
+  const auto roleOf = [&](const int channel) {
+    switch (layout.getTypeOfChannel(channel))
+    {
+      case juce::AudioChannelSet::LFE:
+      case juce::AudioChannelSet::LFE2:
+        return LFE;
+      case juce::AudioChannelSet::topFrontLeft:
+      case juce::AudioChannelSet::topFrontCentre:
+      case juce::AudioChannelSet::topFrontRight:
+      case juce::AudioChannelSet::topRearLeft:
+      case juce::AudioChannelSet::topRearCentre:
+      case juce::AudioChannelSet::topRearRight:
+      case juce::AudioChannelSet::topMiddle:
+        return Height;
+      case juce::AudioChannelSet::left:
+      case juce::AudioChannelSet::right:
+      case juce::AudioChannelSet::centre:
+      case juce::AudioChannelSet::leftCentre:
+      case juce::AudioChannelSet::rightCentre:
+        return Front;
+      default:
+        return Surround;
+    }
+  };
+
+  // Group of each role for the chosen split, in LINK_GROUPS_CHOICES order. Unlinked is one call for every channel.
+  const auto groupOf = [&](const int channel) {
+    const auto role = roleOf(channel);
+    if (!linked || groups == 0)
+      return 0;
+    if (groups == 1)
+      return role == LFE ? 1 : 0;
+    if (groups == 2)
+      return role == LFE ? 2 : role == Height ? 1 : 0;
+    return static_cast<int>(role);
+  };
+
+  // Stable partition by group, so each group is a contiguous run in bus order
+  numLinkGroups_ = 0;
+  auto index     = 0;
+  for (int group = 0; group < NumRoles; ++group)
+  {
+    const auto first = index;
+    for (int channel = 0; channel < numChannels; ++channel)
+      if (groupOf(channel) == group)
+        linkOrder_[static_cast<size_t>(index++)] = channel;
+    if (index > first)
+      linkGroups_[static_cast<size_t>(numLinkGroups_++)] = { first, index - first };
+  }
+}
+
+void Ap_dynamicsAudioProcessor::updateCompressorCurve()
+{
+  using namespace APParameters;
+
+  const auto useTable = parameters_[CurveTable]->load() >= 0.5f;
+  forEachChain([&](auto& chain) {
+    chain.compressor->setCurveMode(useTable ? APCompressorBase::CurveMode::LookupTable
+                                            : APCompressorBase::CurveMode::Analytic);
+    chain.compressor->updateParameters(parameters_[Threshold]->load(), parameters_[Ratio]->load(),
+                                       parameters_[Knee]->load());
+  });
+}
+
+void Ap_dynamicsAudioProcessor::updateLatency()
+{
+  using namespace APParameters;
+
+  const auto multiband = parameters_[Bands]->load() >= 0.5f;
+  const auto bypassed  = parameters_[BypassCompressor]->load() >= 0.5f;
+  const auto lookahead = parameters_[Lookahead]->load() * 0.001f;
+  auto latency         = multiband || bypassed
+                             ? 0
+                             : APCompressorBase::lookaheadToSamples(lookahead, static_cast<float>(getSampleRate()));
+
+  // Every saturator that runs adds its filters' delay, wherever it sits in the chain, and the tube its
+  // anti-aliasing's
+  const auto stages       = juce::roundToInt(parameters_[Oversampling]->load());
+  const auto oversampling = APOversampler<float>::getLatencySamples(
+      stages, static_cast<APOversampler<float>::Phase>(juce::roundToInt(parameters_[OversamplingPhase]->load())));
+  for (const auto bypass : { BypassOverdrive, BypassTube })
+    if (parameters_[bypass]->load() < 0.5f)
+      latency += oversampling;
+  if (parameters_[BypassTube]->load() < 0.5f)
+    latency += tubeAntialiasingLatency(stages, parameters_[Antialiasing]->load() >= 0.5f);
+
+  if (latency != getLatencySamples())
+    setLatencySamples(latency);
+
+  // Output keeps coming for the lookahead plus the filters' ring-out after the input stops
+  const auto sampleRate = getSampleRate();
+  if (sampleRate > 0.0)
+    tailLengthSeconds_ = (latency + APConstants::Math::POST_FILTER_TAIL_SAMPLES) / sampleRate +
+                         (multiband ? APConstants::Math::CROSSOVER_TAIL : 0.0);
+}
+
+void Ap_dynamicsAudioProcessor::resetDSP()
+{
+  forEachChain([](auto& chain) {
+    chain.compressor->reset();
+    chain.overdrive->reset();
+    chain.tubeDistortion->reset();
+    chain.overdriveOversampler->reset();
+    chain.tubeOversampler->reset();
+    chain.dryDelay.clear();
+    chain.dryDelayPosition = 0;
+    chain.postHighPass->reset();
+    chain.postLowPass->reset();
+    chain.mixBuffer.applyGain(0);
+  });
+  multiband_->reset();
 }
 
 void Ap_dynamicsAudioProcessor::reset()
 {
-  compressor_->reset();
+  resetDSP();
+  silentSamples_ = 0;
+  idle_          = false;
 
   auto zero_f = 0.0f;
   meterLocalMaxVal.store(zero_f);
   meterGlobalMaxVal.store(zero_f);
-  makeupSmoothed_.store(zero_f);
-  distQ_.store(zero_f);
-  distChar_.store(zero_f);
-  mixBuffer_.applyGain(0.0f);
-  dryGain_.reset(getSampleRate(), 0.05);
-  wetGain_.reset(getSampleRate(), 0.05);
-  makeup_.reset(getSampleRate(), 0.05);
+  // Start from the current settings rather than ramping in from wherever playback stopped
+  for (auto* ramp : { &dryGain_, &wetGain_, &makeup_, &distQ_, &distChar_, &overdriveMix_ })
+    ramp->setCurrentAndTargetValue(ramp->getTargetValue());
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout Ap_dynamicsAudioProcessor::createParameters()
@@ -306,45 +1009,28 @@ juce::AudioProcessorValueTreeState::ParameterLayout Ap_dynamicsAudioProcessor::c
   const auto valueToTextFunction = [](float val, int len) { return juce::String(val, len); };
   const auto textToValueFunction = [](const juce::String& text) { return text.getFloatValue(); };
 
-  // Threshold
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::THRESHOLD_ID, APParameters::THRESHOLD_NAME,
-      juce::NormalisableRange<float>(APParameters::THRESHOLD_START, APParameters::THRESHOLD_END,
-                                     APParameters::THRESHOLD_INTERVAL),
-      APParameters::THRESHOLD_DEFAULT, APParameters::THRESHOLD_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
-  // Ratio
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::RATIO_ID, APParameters::RATIO_NAME,
-      juce::NormalisableRange<float>(APParameters::RATIO_START, APParameters::RATIO_END, APParameters::RATIO_INTERVAL,
-                                     APParameters::RATIO_SKEW),
-      APParameters::RATIO_DEFAULT, APParameters::RATIO_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
-  // Global Mix
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::MIX_ID, APParameters::MIX_NAME,
-      juce::NormalisableRange<float>(APParameters::MIX_START, APParameters::MIX_END, APParameters::MIX_INTERVAL),
-      APParameters::MIX_DEFAULT, APParameters::MIX_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
-  // Distortion Q
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::DISTQ_ID, APParameters::DISTQ_NAME,
-      juce::NormalisableRange<float>(APParameters::DISTQ_START, APParameters::DISTQ_END, APParameters::DISTQ_INTERVAL),
-      APParameters::DISTQ_DEFAULT, APParameters::DISTQ_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
-  // Distortion Characteristic
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::DIST_CHAR_ID, APParameters::DIST_CHAR_NAME,
-      juce::NormalisableRange<float>(APParameters::DIST_CHAR_START, APParameters::DIST_CHAR_END,
-                                     APParameters::DIST_CHAR_INTERVAL),
-      APParameters::DIST_CHAR_DEFAULT, APParameters::DIST_CHAR_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
-  // Makeup
-  parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
-      APParameters::MAKEUP_ID, APParameters::MAKEUP_NAME,
-      juce::NormalisableRange<float>(APParameters::MAKEUP_START, APParameters::MAKEUP_END, APParameters::MAKEUP_INTERVAL),
-      APParameters::MAKEUP_DEFAULT, APParameters::MAKEUP_SUFFIX, juce::AudioProcessorParameter::genericParameter,
-      valueToTextFunction, textToValueFunction));
+  for (const auto& parameter : APParameters::REGISTRY)
+  {
+    switch (parameter.type)
+    {
+      case APParameters::Type::Float:
+        parameters.emplace_back(std::make_unique<juce::AudioParameterFloat>(
+            parameter.id, parameter.name,
+            juce::NormalisableRange<float>(parameter.start, parameter.end, parameter.interval, parameter.skew),
+            parameter.defaultValue, parameter.suffix, juce::AudioProcessorParameter::genericParameter,
+            valueToTextFunction, textToValueFunction));
+        break;
+      case APParameters::Type::Choice:
+        parameters.emplace_back(std::make_unique<juce::AudioParameterChoice>(
+            parameter.id, parameter.name, juce::StringArray(parameter.choices, parameter.numChoices),
+            juce::roundToInt(parameter.defaultValue)));
+        break;
+      case APParameters::Type::Bool:
+        parameters.emplace_back(
+            std::make_unique<juce::AudioParameterBool>(parameter.id, parameter.name, parameter.defaultValue >= 0.5f));
+        break;
+    }
+  }
 
   return { parameters.begin(), parameters.end() };
 }
@@ -12,13 +12,19 @@
 #include "juce_dsp/juce_dsp.h"
 
 #include "../DSP/APCompressor.h"
+#include "../DSP/APMultibandCompressor.h"
 #include "../DSP/APOverdrive.h"
+#include "../DSP/APOversampler.h"
 #include "../DSP/APTubeDistortion.h"
+#include "../Helpers/APDefines.h"
+#include "../Helpers/APParameterRamp.h"
+
+#include <variant>
 
 //==============================================================================
 /**
  */
-class Ap_dynamicsAudioProcessor : public juce::AudioProcessor, public juce::ValueTree::Listener
+class Ap_dynamicsAudioProcessor : public juce::AudioProcessor, private juce::AsyncUpdater
 {
  public:
   //==============================================================================
@@ -34,6 +40,8 @@ class Ap_dynamicsAudioProcessor : public juce::AudioProcessor, public juce::Valu
 #endif
 
   void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+  void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+  bool supportsDoublePrecisionProcessing() const override { return true; }
 
   //==============================================================================
   juce::AudioProcessorEditor* createEditor() override;
@@ -66,41 +74,278 @@ class Ap_dynamicsAudioProcessor : public juce::AudioProcessor, public juce::Valu
   std::atomic<float> meterLocalMaxVal {0.0f};
   std::atomic<float> meterGlobalMaxVal {0.0f};
 
-  // Updates DSP when user changes parameters
-  void update();
+  using Parameter = APParameters::Index;
+  static_assert(APParameters::NumParameters < 64, "one dirty bit per parameter");
+  static constexpr uint64_t AllParameters = (uint64_t { 1 } << APParameters::NumParameters) - 1;
+  static constexpr uint64_t bit(const int parameter) { return uint64_t { 1 } << parameter; }
+
+  // Re-derives the DSP settings that depend on the parameters flagged in changed, leaving the rest alone
+  void update(uint64_t changed = AllParameters);
   // Overrides AudioProcessor reset, reset DSP parameters
   void reset() override;
   // Create parameter layout for apvts
   static juce::AudioProcessorValueTreeState::ParameterLayout createParameters();
 
  private:
-  std::atomic<bool> mustUpdateProcessing_{ false }, isActive_{ false }; // TODO: Consider making std::atomic<bool>
-  std::atomic<float> makeupSmoothed_ {0.0f};
+  std::atomic<bool> isActive_ { false };
+
+  // Raises one parameter's dirty bits from whichever thread changed it, with no string lookup and no lock
+  struct ParameterFlag : juce::AudioProcessorValueTreeState::Listener
+  {
+    Ap_dynamicsAudioProcessor* owner = nullptr;
+    uint64_t mask                    = 0;
+    void parameterChanged(const juce::String&, float) override
+    {
+      owner->audioDirty_.fetch_or(mask, std::memory_order_release);
+      owner->messageDirty_.fetch_or(mask, std::memory_order_release);
+      if ((mask & (curveParameters() | latencyParameters())) != 0)
+        owner->triggerAsyncUpdate();
+    }
+  };
+  // Parameters behind the compressor curve and behind the reported latency, applied in handleAsyncUpdate()
+  static constexpr uint64_t curveParameters()
+  {
+    using namespace APParameters;
+    return bit(Threshold) | bit(Ratio) | bit(Knee) | bit(CurveTable);
+  }
+  static constexpr uint64_t latencyParameters()
+  {
+    using namespace APParameters;
+    return bit(Lookahead) | bit(Bands) | bit(BypassCompressor) | bit(BypassOverdrive) | bit(BypassTube) |
+           bit(Oversampling) | bit(OversamplingPhase) | bit(Antialiasing);
+  }
+  // Values looked up by ID once, in the constructor, then indexed by APParameters::Index
+  std::array<std::atomic<float>*, APParameters::NumParameters> parameters_ {};
+  std::array<ParameterFlag, APParameters::NumParameters> parameterFlags_ {};
+  // Changed since the audio thread last took them, and since the message thread last took them (curve, latency)
+  std::atomic<uint64_t> audioDirty_ { 0 };
+  std::atomic<uint64_t> messageDirty_ { 0 };
+  // Values the current settings were derived from, audio thread only. Reloaded per parameter as its bit comes in
+  // and read-only for the rest of the block.
+  std::array<float, APParameters::NumParameters> snapshot_ {};
 
   // Mixing
-  juce::LinearSmoothedValue<float> dryGain_, wetGain_, makeup_; // consider make unique_ptr
-  juce::AudioBuffer<float> mixBuffer_;
+  APParameterRamp dryGain_, wetGain_, makeup_;
+  // Per-sample values of the ramping parameters for the current block, one channel per ramp
+  enum RampChannel { DryRamp, WetRamp, MakeupRamp, DistQRamp, DistCharRamp, OverdriveMixRamp, NumRampChannels };
+  juce::AudioBuffer<float> rampBuffer_;
+  // A gain over one block: constant, or ramp (one value per sample, in a channel of rampBuffer_)
+  struct BlockGain
+  {
+    float value;
+    const float* ramp;
+  };
 
-  // Post-Processing Filters
-  using Filter = juce::dsp::ProcessorDuplicator<dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>;
-  std::unique_ptr<Filter> postHighPass_; // post high pass
-  std::unique_ptr<Filter> postLowPass_; // post low pass
+  // Samples per pass through the whole chain: small enough that a tile of every channel, its dry copy and the
+  // ramps stay in L1 between stages, and a multiple of every DSP class's internal chunk so tiling leaves their
+  // output unchanged
+  static constexpr int TILE_SIZE = 256;
 
-  std::unique_ptr<APCompressor> compressor_;
-  std::unique_ptr<APOverdrive> overdrive_;
+  // The sample-type dependent part of the signal path. Both precisions are prepared, processBlock runs the one
+  // matching the buffer the host hands it, so 64-bit hosts never convert.
+  template <typename SampleType>
+  struct DSPChain
+  {
+    using Sample = SampleType;
+    using Filter = juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<SampleType>,
+                                                  juce::dsp::IIR::Coefficients<SampleType>>;
+
+    // Post-Processing Filters
+    std::unique_ptr<Filter> postHighPass = std::make_unique<Filter>();
+    std::unique_ptr<Filter> postLowPass  = std::make_unique<Filter>();
+
+    std::unique_ptr<APCompressor<SampleType>> compressor         = std::make_unique<APCompressor<SampleType>>();
+    std::unique_ptr<APOverdrive<SampleType>> overdrive           = std::make_unique<APOverdrive<SampleType>>();
+    std::unique_ptr<APTubeDistortion<SampleType>> tubeDistortion = std::make_unique<APTubeDistortion<SampleType>>();
 
-  std::atomic<float> distQ_ {0.0f };
-  std::atomic<float> distChar_ {0.0f };
-  std::unique_ptr<APTubeDistortion> tubeDistortion_;
+    // One per saturator, each with the filter state of its own point in the chain
+    using Oversampler = APOversampler<SampleType>;
+    std::unique_ptr<Oversampler> overdriveOversampler = std::make_unique<Oversampler>();
+    std::unique_ptr<Oversampler> tubeOversampler      = std::make_unique<Oversampler>();
 
-  // Callback for DSP parameter changes
-  void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyChanged, const juce::Identifier& property) override
+    juce::AudioBuffer<SampleType> mixBuffer;
+    // Ring per channel holding the dry path back by dryDelaySamples_, the first dryDelaySamples_ samples in use
+    juce::AudioBuffer<SampleType> dryDelay;
+    int dryDelayPosition = 0;
+    // Per channel input, output and sidechain key in linkOrder_, sized in prepareToPlay
+    std::vector<const SampleType*> inputPointers, keyPointers;
+    std::vector<SampleType*> outputPointers;
+  };
+  DSPChain<float> floatChain_;
+  DSPChain<double> doubleChain_;
+
+  template <typename SampleType>
+  DSPChain<SampleType>& getChain()
   {
-    // Function parameters not needed for value tree state
-    ignoreUnused(treeWhosePropertyChanged);
-    ignoreUnused(property);
+    if constexpr (std::is_same_v<SampleType, float>)
+      return floatChain_;
+    else
+      return doubleChain_;
+  }
+  template <typename Function>
+  void forEachChain(Function&& function)
+  {
+    function(floatChain_);
+    function(doubleChain_);
+  }
 
-    mustUpdateProcessing_ = true;
+  // Float only: four bands fill one float SIMD register. The double path runs it on a float copy of each channel.
+  std::unique_ptr<APMultibandCompressor> multiband_;
+  juce::AudioBuffer<float> multibandBuffer_;
+  bool multibandEnabled_ = false;  // audio thread only, set in update()
+
+  // Compressor link groups over the main bus, up to 7.1.4. The channels go to the compressor in linkOrder_, each
+  // group a contiguous run of it, so one group is one process() call and keeps the same detector slots block to
+  // block. Unlinked, the whole bus is one call and the compressor runs the channels side by side.
+  static constexpr int MAX_CHANNELS = 12;
+  struct LinkGroup
+  {
+    int first = 0;
+    int count = 0;
+  };
+  std::array<int, MAX_CHANNELS> linkOrder_ {};
+  std::array<LinkGroup, MAX_CHANNELS> linkGroups_ {};
+  int numLinkGroups_ = 0;  // audio thread only, set in update()
+
+  // Stereo buses run compression and distortion on mid and side, each channel with its own detector state
+  bool midSide_ = false;  // audio thread only, set in update()
+
+  // Stages of the signal path. The dry side of the mix is tapped after the compressor: stages before it run in
+  // series on the whole signal, stages after it only on the wet path. The post filters always close the wet path.
+  enum class Stage { Compressor, Overdrive, Tube, Filters, NumStages };
+  template <Stage... Stages>
+  struct StageList
+  {
+    static constexpr Stage stages[] { Stages... };
+    static constexpr int position(const Stage stage)
+    {
+      for (int i = 0; i < static_cast<int>(sizeof...(Stages)); ++i)
+        if (stages[i] == stage)
+          return i;
+      return -1;
+    }
+    static constexpr bool isWet(const Stage stage) { return position(stage) > position(Stage::Compressor); }
+  };
+  // One alternative per APParameters::STAGE_ORDER_CHOICES entry. processSamples visits it once per block and the
+  // tile loop is compiled per order, so the stages are inlined in sequence with no indirect call between them.
+  using StageOrders = std::variant<StageList<Stage::Compressor, Stage::Overdrive, Stage::Tube, Stage::Filters>,
+                                   StageList<Stage::Compressor, Stage::Tube, Stage::Overdrive, Stage::Filters>,
+                                   StageList<Stage::Overdrive, Stage::Compressor, Stage::Tube, Stage::Filters>,
+                                   StageList<Stage::Tube, Stage::Compressor, Stage::Overdrive, Stage::Filters>>;
+  static_assert(std::variant_size_v<StageOrders> == std::size(APParameters::STAGE_ORDER_CHOICES),
+                "one chain order per choice");
+  template <size_t... Index>
+  static StageOrders makeStageOrder(const int choice, std::index_sequence<Index...>)
+  {
+    StageOrders order;
+    ((choice == static_cast<int>(Index) ? void(order.emplace<Index>()) : void()), ...);
+    return order;
+  }
+  StageOrders stageOrder_;  // audio thread only, set in update()
+  // A bypassed stage costs its one test per tile. Audio thread only, set in update().
+  std::array<bool, static_cast<size_t>(Stage::NumStages)> bypassed_ {};
+  bool isBypassed(const Stage stage) const { return bypassed_[static_cast<size_t>(stage)]; }
+
+  APParameterRamp distQ_, distChar_;
+  // The overdrive's blend follows Mix at the rate the wet and dry gains do, so Mix automation doesn't step it
+  APParameterRamp overdriveMix_;
+  // The saturators' ramps held over the oversampled samples of one tile, one channel each: the tube's Q and
+  // characteristic, then the overdrive's mix
+  juce::AudioBuffer<float> oversampledRamps_;
+  // ramp from sample start, each value held over the samples an oversampling factor puts in between, in channel
+  // of oversampledRamps_. ramp itself, offset to start, when nothing is oversampled.
+  const float* holdRamp(const float* ramp, int channel, int start, int numSamples, int factor);
+
+  // Oversampled saturators on the wet path delay it against the dry path, which is held back by as much. Audio
+  // thread only, set in update(), along with the latency of every saturator that runs, oversampling and the tube's
+  // anti-aliasing both, for the silence tail.
+  int dryDelaySamples_  = 0;
+  int saturatorLatency_ = 0;
+
+  // The tube's anti-aliasing delays it by a sample at the rate it runs, a whole one to compensate only while it is
+  // not oversampled. Oversampled, it is a fraction of a sample, as is the overdrive's half sample at any rate, and
+  // those are left uncompensated.
+  static int tubeAntialiasingLatency(const int oversamplingStages, const bool antialiased)
+  {
+    return antialiased && oversamplingStages == 0 ? APTubeDistortion<float>::ANTIALIASING_LATENCY : 0;
+  }
+
+  // Silence and bypass tracking, audio thread only
+  int silentSamples_       = 0;
+  int silenceTailSamples_  = 0;      // set in update()
+  bool idle_               = false;  // past the tail of a silent input, processing skipped
+  bool filtersBypassed_    = false;  // post filters skipped last block and cleared
+  std::atomic<double> tailLengthSeconds_ { 0.0 };  // set in updateLatency()
+
+  // What the stages need to know about the current block, gathered once per block by processSamples
+  template <typename SampleType>
+  struct BlockContext
+  {
+    DSPChain<SampleType>& chain;
+    juce::AudioBuffer<SampleType>& buffer;
+    const juce::AudioBuffer<SampleType>& sidechain;
+    juce::dsp::AudioBlock<SampleType> mainBlock;
+    int numInputChannels, numChannels, numSidechainChannels;
+    bool midSide, dryActive, wetActive, filtersActive;
+    BlockGain dryGain, wetGain, makeup;
+    const float* distQRamp;  // per-sample tube parameters for the block, both nullptr while settled
+    const float* distCharRamp;
+    const float* overdriveMixRamp;  // per-sample overdrive blend for the block, nullptr while settled
+  };
+
+  template <typename SampleType>
+  void processSamples(juce::AudioBuffer<SampleType>& buffer);
+  // The block tile by tile, each tile through every stage in Stages order, then the mix and makeup
+  template <typename SampleType, Stage... Stages>
+  void processTiles(StageList<Stages...>, BlockContext<SampleType>& context, int numSamples);
+  // One stage over samples [start, start + numSamples) of every channel. Wet stages are skipped with the wet path.
+  template <Stage stage, bool wet, typename SampleType>
+  void processStage(BlockContext<SampleType>& context, int start, int numSamples);
+  // Runs process(channel, data, numSamples) over samples [start, start + numSamples) of every channel, at the
+  // oversampler's rate while it is on
+  template <typename SampleType, typename Process>
+  void processSaturator(BlockContext<SampleType>& context, APOversampler<SampleType>& oversampler, int start,
+                        int numSamples, Process&& process);
+  // The compressor output of the tile through dryDelaySamples_ of delay, into the dry buffer while both sides of
+  // the mix are live, in place while only the dry side is, so the latency stays what updateLatency() reported
+  template <typename SampleType>
+  void delayDry(BlockContext<SampleType>& context, int start, int numSamples);
+  // Fills the block's ramp values when gain is ramping, or advances a ramp whose values are never used
+  BlockGain prepareGain(APParameterRamp& gain, RampChannel channel, int numSamples);
+  static BlockGain skipGain(APParameterRamp& gain, int numSamples);
+  // Multiplies samples [start, start + numSamples) of the first numChannels of buffer by gain
+  template <typename SampleType>
+  static void applyGain(const BlockGain& gain, juce::AudioBuffer<SampleType>& buffer, int numChannels, int start,
+                        int numSamples);
+  // One pass over a stereo pair: records the L/R ranges in leftRight and writes M = (L + R) / 2, S = (L - R) / 2 in
+  // place
+  template <typename SampleType>
+  static void encodeMidSide(SampleType* left, SampleType* right, int numSamples, juce::Range<SampleType>* leftRight);
+  // The inverse, L = M + S, R = M - S, over samples [start, start + numSamples), fused with the gain so the
+  // decode costs no pass of its own
+  template <typename SampleType>
+  static void decodeMidSide(const BlockGain& gain, juce::AudioBuffer<SampleType>& buffer, int start,
+                            int numSamples);
+
+  // Clears every filter, delay line and detector, leaving parameters and ramps alone
+  void resetDSP();
+  // Rebuilds the compressor's static curve off the audio thread, see APCompressor::updateParameters
+  void updateCompressorCurve();
+  // Rebuilds linkOrder_ and linkGroups_ from the main bus layout and the link parameters
+  void updateLinkGroups();
+  // Reports the compressor lookahead, the oversampling filters' delay and the output tail to the host. Multiband
+  // runs without lookahead, and a bypassed stage without any delay.
+  void updateLatency();
+
+  // Message thread side of parameter changes: the work that has to stay off the audio thread, only when its
+  // parameters moved. Triggered by the parameter listeners, and run from the audio thread in offline renders.
+  void handleAsyncUpdate() override
+  {
+    const auto changed = messageDirty_.exchange(0, std::memory_order_acquire);
+    if ((changed & curveParameters()) != 0)
+      updateCompressorCurve();
+    if ((changed & latencyParameters()) != 0)
+      updateLatency();
   }
   //==============================================================================
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Ap_dynamicsAudioProcessor)
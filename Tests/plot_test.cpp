@@ -32,7 +32,7 @@ juce::AudioBuffer<float> loadFile(const juce::String& path)
 }
 
 void processSamplesWithCompression(juce::AudioBuffer<float>& buffer,
-                                   APCompressor& compressor)  // [td] make process non-destructive
+                                   APCompressor<float>& compressor)  // [td] make process non-destructive
 {
   juce::ScopedNoDenormals noDenormals;
   auto numChannels = buffer.getNumChannels();
@@ -44,7 +44,7 @@ void processSamplesWithCompression(juce::AudioBuffer<float>& buffer,
   }
 }
 
-void processSamplesWithDistortion(juce::AudioBuffer<float>& buffer, APTubeDistortion& distortion)
+void processSamplesWithDistortion(juce::AudioBuffer<float>& buffer, APTubeDistortion<float>& distortion)
 {
   juce::ScopedNoDenormals noDenormals;
   auto numChannels = buffer.getNumChannels();
@@ -72,7 +72,7 @@ void processSamplesWithDistortion(juce::AudioBuffer<float>& buffer, APTubeDistor
   DBG(buffer.getSample(0, 100));
 }
 
-void processSamplesWithOverdrive(juce::AudioBuffer<float>& buffer, APOverdrive& overdrive)
+void processSamplesWithOverdrive(juce::AudioBuffer<float>& buffer, APOverdrive<float>& overdrive)
 {
   juce::ScopedNoDenormals noDenormals;
   auto numChannels = buffer.getNumChannels();
@@ -205,11 +205,11 @@ juce::Image generatePlots(const juce::String& file_path, ProcessType type)
 
   auto audio_buffer = loadFile(file_path);
 
-  APCompressor compressor;
+  APCompressor<float> compressor;
   compressor.setSampleRate(44100.0f);
   compressor.updateParameters(-24.0f, 14.0f);
-  APTubeDistortion distortion;
-  APOverdrive overdrive;
+  APTubeDistortion<float> distortion;
+  APOverdrive<float> overdrive;
 
   // Draw top and bottom plot backgrounds
   plot_graphics.setColour(juce::Colours::white);